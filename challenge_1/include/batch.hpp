@@ -0,0 +1,211 @@
+#pragma once
+
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+
+#include "optimizer.hpp"
+
+// Queues of the tasks of a pool of threads with work stealing
+class task_queues{
+    /**
+     * @brief One double-ended queue of task indexes for each thread: the owner takes the tasks from the back, when its
+     * queue is empty it steals from the front of the queues of the other threads, so the threads with the fast tasks
+     * run the tasks of the slow ones
+    */
+
+    struct queue{
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<queue> queues;
+
+  public:
+    task_queues(const size_t threads, const size_t tasks): queues(threads){
+        /**
+         * @brief Constructor, the tasks are given to the threads in turn
+         * @param threads: number of threads
+         * @param tasks: number of tasks, with indexes from 0 to tasks - 1
+        */
+        for(size_t i = 0; i < tasks; i++)
+            queues[i % threads].tasks.push_back(i);
+    }
+
+    bool pop(const size_t thread, size_t & task){
+        /**
+         * @brief Take a task for a thread
+         * @param thread: index of the thread
+         * @param task: index of the task taken
+         * @return false if all the queues are empty
+        */
+        {
+            std::lock_guard<std::mutex> lock(queues[thread].mutex);
+            if(!queues[thread].tasks.empty()){
+                task = queues[thread].tasks.back();
+                queues[thread].tasks.pop_back();
+                return true;
+            }
+        }
+
+        for(size_t i = 1; i < queues.size(); i++){
+            queue & victim = queues[(thread + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty()){
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Result of a multi-start
+struct batch_result{
+    /**
+     * @brief Table of the runs, in the order of the initial guesses, and the distinct minima found
+    */
+    std::vector<vector> starts;
+    std::vector<result> runs;
+    // for each run the index of its minimum, -1 if it did not converge to a minimum
+    std::vector<int> minimum;
+
+    std::vector<vector> minima;
+    std::vector<format> values;
+
+    // wall time of the multi-start, in milliseconds
+    double time = 0;
+    size_t threads = 0;
+
+    int best() const{
+        /**
+         * @brief Global minimum
+         * @return index of the lowest minimum, -1 if no run converged
+        */
+        int best = -1;
+        for(size_t j = 0; j < values.size(); j++)
+            if(best < 0 || values[j] < values[best])
+                best = j;
+        return best;
+    }
+};
+
+std::vector<vector> random_starts(const size_t count, const vector & lower, const vector & upper, const unsigned seed){
+  /** @brief Random initial guesses with uniform distribution in a box
+   *  @param count: number of initial guesses
+   *  @param lower: lower corner of the box
+   *  @param upper: upper corner of the box
+   *  @param seed: seed of the generator
+   *  @return initial guesses
+   */
+  std::mt19937 generator(seed);
+  std::vector<vector> starts(count, vector(lower.size()));
+  for(auto & x : starts)
+    for(size_type i = 0; i < x.size(); i++)
+      x[i] = std::uniform_real_distribution<format>(lower[i], upper[i])(generator);
+  return starts;
+}
+
+batch_result multi_start(const parameters & p, const std::vector<vector> & starts){
+  /** @brief Minimize the function from many initial guesses on a pool of threads with work stealing
+   *  @note Each run has its own wrappers and computes its gradient in its thread. When a run converges to a point
+   *  with gradient under p.minimum_residual and not near (p.radius) a minimum already found, the point is a new
+   *  minimum; a run stops as soon as x is near a minimum already found, without the iterations to converge to it
+   *  again. An exception in a run is thrown again by the caller after all the threads end
+   *  @param p: parameters, x0 is replaced by each initial guess
+   *  @param starts: initial guesses
+   *  @return table of the runs and minima found
+   */
+
+  const auto start = std::chrono::steady_clock::now();
+
+  batch_result b;
+  b.starts = starts;
+  b.runs.resize(starts.size());
+  b.minimum.assign(starts.size(), -1);
+  b.threads = p.threads > 0 ? p.threads : std::max(std::thread::hardware_concurrency(), 1u);
+  b.threads = std::max<size_t>(std::min(b.threads, starts.size()), 1);
+
+  std::shared_mutex mutex;
+  auto known = [&](const vector & x){
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    for(size_t j = 0; j < b.minima.size(); j++)
+      if(distance(x, b.minima[j]) < p.radius)
+        return static_cast<int>(j);
+    return -1;
+  };
+  const stop_function stop = [&](const vector & x){ return known(x) >= 0; };
+
+  task_queues queues(b.threads, starts.size());
+  std::vector<std::exception_ptr> errors(b.threads);
+  std::vector<std::thread> pool;
+
+  for(size_t t = 0; t < b.threads; t++)
+    pool.emplace_back([&, t](){
+      try{
+        size_t i;
+        while(queues.pop(t, i)){
+          parameters q = p;
+          q.x0 = starts[i];
+          q.parallel_gradient = false;
+          const result r = run(q, stop);
+          b.runs[i] = r;
+
+          if(r.stopped)
+            b.minimum[i] = known(r.x);
+          else if(r.converged && r.residual < p.minimum_residual){
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            int j = 0;
+            while(j < static_cast<int>(b.minima.size()) && distance(r.x, b.minima[j]) >= p.radius)
+              j++;
+            if(j == static_cast<int>(b.minima.size())){
+              b.minima.push_back(r.x);
+              b.values.push_back(r.value);
+            }
+            b.minimum[i] = j;
+          }
+        }
+      }
+      catch(...){
+        errors[t] = std::current_exception();
+      }
+    });
+
+  for(auto & thread : pool)
+    thread.join();
+  for(auto & error : errors)
+    if(error)
+      std::rethrow_exception(error);
+
+  b.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return b;
+}
+
+void display_batch(const batch_result & b){
+  std::cout << "\n++++++++++++++++++++++++++++++++++++" << std::endl;
+  std::cout << "++++++++++++ MULTI-START +++++++++++" << std::endl;
+  std::cout << "++++++++++++++++++++++++++++++++++++\n" << std::endl;
+  std::cout << std::left << std::setw(6) << "Run" << std::setw(10) << "Minimum" << std::right << std::setw(14) << "Value"
+            << std::setw(8) << "Iter" << std::setw(8) << "Evals" << std::setw(12) << "Time (ms)" << std::endl;
+  for(size_t i = 0; i < b.runs.size(); i++){
+    const result & r = b.runs[i];
+    std::cout << std::left << std::setw(6) << i << std::setw(10) << (b.minimum[i] < 0 ? "-" : std::to_string(b.minimum[i]))
+              << std::right << std::setw(14) << r.value << std::setw(8) << r.iterations << std::setw(8) << r.evaluations
+              << std::setw(12) << r.time << (r.stopped ? "  (stopped)" : "") << std::endl;
+  }
+
+  std::cout << "\n- Minima found: " << b.minima.size() << std::endl;
+  for(size_t j = 0; j < b.minima.size(); j++){
+    std::cout << "  " << j << ": " << b.values[j] << " in [ ";
+    for(auto & i : b.minima[j])
+      std::cout << i << " ";
+    std::cout << "]" << std::endl;
+  }
+  if(b.best() >= 0)
+    std::cout << "- Global minimum: " << b.values[b.best()] << std::endl;
+  std::cout << "- Time: " << b.time << " ms with " << b.threads << " threads" << std::endl;
+}
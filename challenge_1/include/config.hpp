@@ -2,27 +2,32 @@
 
 #include <vector>
 #include <cmath>
-
-/**
- * @brief Mode of the program
- * 0 - Default
- * 1 - Heavy Ball
- * 2 - Nesterov
-*/ 
-#define mode 1
-
-/**
- * @brief Use the right gradient or approximate it
- * 0 - Use the right gradient
- * 1 - Approximate the gradient
-*/
-#define grad_mode 1
+#include <utility>
 
 // Define the type of the variables, in this way is easy to change update for example to float or to Eigen::VectorXd
+// (with Eigen: #include <Eigen/Dense>, typedef Eigen::VectorXd vector; x0 = vector::Zero(2) and lower, upper in the same way in parameters)
 typedef double format;
 typedef std::vector<format> vector;
+// Type of the indexes of a vector, size_t for std::vector and Eigen::Index for Eigen::VectorXd
+typedef decltype(std::declval<vector>().size()) size_type;
 
 struct parameters {
+  /*
+  Method to update x_k, chosen at runtime:
+  0 - Default
+  1 - Heavy Ball
+  2 - Nesterov
+  3 - L-BFGS
+  */
+  int mode = 1;
+
+  /*
+  Use the right gradient or approximate it:
+  0 - Use the right gradient
+  1 - Approximate the gradient
+  */
+  int grad_mode = 1;
+
   /* 
   Strategy of decay:
   1 - exponential
@@ -49,6 +54,32 @@ struct parameters {
 
   // step-lentgh for the approximate gradient
   format h = 1e-6;
+  // forward differences, n evaluations instead of 2n for each gradient
+  bool forward_difference = false;
+
+  // parameters for L-BFGS: number of pairs (s, y) stored, constants of the strong Wolfe conditions and maximum
+  // number of evaluations of the line search
+  int memory = 10;
+  format c1 = 1e-4;
+  format c2 = 0.9;
+  int line_search_iter = 20;
+
+  // after the run with these parameters, run all the methods and strategies and print a table of the results
+  bool compare_methods = true;
+
+  // multi-start: number of random initial guesses in the box [lower, upper] (0 to skip it), seed of the generator,
+  // threads (0 for all the cores), distance under which two points are the same minimum and norm of the gradient
+  // under which a converged run is a minimum
+  int starts = 0;
+  vector lower{-2, -2};
+  vector upper{2, 2};
+  unsigned seed = 1;
+  int threads = 0;
+  format radius = 1e-3;
+  format minimum_residual = 1e-3;
+
+  // split the coordinates of the approximate gradient among the OpenMP threads, the multi-start disables it
+  bool parallel_gradient = true;
 };
 
 
@@ -62,14 +93,11 @@ format function(const vector & x){
 }
 
 
-vector gradient(const vector & x){
+void gradient(const vector & x, vector & grad){
   /** @brief Gradient of the function to be minimized
    *  @param x: vector of variables
-   *  @return gradient of the function
+   *  @param grad: gradient of the function, of the same size of x
    */
-  vector grad(x.size());
   grad[0] = x[1] + 16*std::pow(x[0], 3) + 3;
   grad[1] = x[0] + 2*x[1];
-
-  return grad;
 }
\ No newline at end of file
@@ -0,0 +1,502 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "util.hpp"
+#include "config.hpp"
+
+template<int strategy>
+format decay(const parameters & p, const vector & x, const int k, const gradient_wrapper & grad, const function_wrapper & f, workspace & w){
+
+  /**
+   *  @brief Function to decay the learning rate
+   *  @param p: parameters
+   *  @param x: vector of variables
+   *  @param k: iteration number
+   *  @param w: buffers of the line search
+   *  @return new learning rate
+   */
+
+  // exponential decay
+  if constexpr (strategy == 1)
+    return p.alpha_0 * exp(-p.mu * k);
+
+  // inverse decay
+  else if constexpr (strategy == 2)
+    return p.alpha_0 / (1 + p.mu * k);
+
+  // approximate line search with Armijo rule
+  else {
+    // check condition
+    bool exit = false;
+
+    // temporary variables: gradient in x and trial point x - alpha * grad
+    grad(x, w.grad);
+    const format temp_norm = norm2(w.grad), f_x = f(x);
+    format temp_alpha = p.alpha_0;
+    axpby(w.x, 1, x, -temp_alpha, w.grad);
+
+    while (!exit) {
+
+      // check condition of Amijo rule
+      if(f_x - f(w.x) >= p.sigma * temp_alpha * temp_norm * temp_norm)
+        exit = true;
+      else{
+        temp_alpha /= 2;
+        axpby(w.x, 1, x, -temp_alpha, w.grad);
+      }
+    }
+
+    return temp_alpha;
+  }
+}
+
+result make_result(const vector & x, const format residual, const format step, const int k, const bool converged, const bool stopped, const function_wrapper & f){
+  /**
+   *  @brief Collect the result of a method
+   *  @param x: point found
+   *  @param residual: norm of the gradient in x
+   *  @param step: norm of the last step
+   *  @param k: iterations done
+   *  @param converged: true if the stopping criteria were satisfied
+   *  @param stopped: true if the stop function of the caller stopped the method
+   *  @param f: function minimized
+   *  @return result of the method
+   */
+  result r;
+  r.x = x;
+  r.value = f(x);
+  r.residual = residual;
+  r.step = step;
+  r.iterations = k;
+  r.evaluations = f.evaluations;
+  r.converged = converged;
+  r.stopped = stopped;
+  return r;
+}
+
+/*
+Each method is a class template on the strategy to decay alpha, with:
+- armijo: true if the method supports the Armijo rule, which searches along -grad f(x)
+- minimize(p, grad, f, stop): the minimization from p.x0; after each iteration which does not satisfy the stopping
+  criteria, the method stops if stop(x) is true (stop can be empty)
+*/
+
+// Function of the caller to stop a method before the stopping criteria
+typedef std::function<bool(const vector & x)> stop_function;
+
+template<int strategy>
+struct default_method{
+  static constexpr bool armijo = true;
+
+  static result minimize(const parameters & p, const gradient_wrapper & grad, const function_wrapper & f, const stop_function & stop){
+    /**
+     *  @brief Gradient descent algorithm
+     *  @note All the vectors are allocated before the loop, which updates them in place
+     *  @param p: parameters
+     *  @param stop: function to stop the method in x, can be empty
+     *  @return result of the method
+     */
+
+    int k = 0;
+    format alpha = p.alpha_0;
+    bool exit = false, stopped = false;
+    size_type x_size = p.x0.size();
+
+    vector x_old(p.x0), x_diff(x_size);
+    vector x(p.x0), temp_grad(x_size);
+    workspace w(x_size);
+    format step = 0;
+
+    // update x
+    grad(x, temp_grad);
+    axpy(x, -alpha, temp_grad);
+
+    while(!exit and !stopped and k < p.max_iter){
+      ++k;
+
+      // check variables update
+      step = axpby(x_diff, 1, x, -1, x_old);
+      grad(x, temp_grad);
+
+      if(norm2(temp_grad) < p.residual || step < p.step_length)
+        exit = true;
+      else if(stop && stop(x))
+        stopped = true;
+      else{
+        alpha = decay<strategy>(p, x, k, grad, f, w);
+
+        // save the old value of x
+        x_old = x;
+
+        // update x, temp_grad is already the gradient in x
+        axpy(x, -alpha, temp_grad);
+      }
+
+    }
+
+    return make_result(x, norm2(temp_grad), step, k, exit, stopped, f);
+  }
+};
+
+template<int strategy>
+struct heavy_ball{
+  static constexpr bool armijo = false;
+
+  static result minimize(const parameters & p, const gradient_wrapper & grad, const function_wrapper & f, const stop_function & stop){
+    /**
+     *  @brief Gradient descent algorithm with heavy-ball method
+     *  @note All the vectors are allocated before the loop, which updates them in place
+     *  @param p: parameters
+     *  @param stop: function to stop the method in x, can be empty
+     *  @return result of the method
+     */
+
+    int k = 0;
+    format alpha = p.alpha_0;
+    bool exit = false, stopped = false;
+    size_type x_size = p.x0.size();
+
+    vector x(p.x0), temp_grad(x_size), d(x_size);
+    workspace w(x_size);
+    format step = 0;
+    grad(x, temp_grad);
+
+    // Calculate the value of d (d_0)
+    axpby(d, -alpha, temp_grad, 0, temp_grad);
+
+    while(!exit and !stopped and k < p.max_iter){
+      ++k;
+
+      // update x, the step x - x_old is d
+      step = axpy(x, 1, d);
+
+      // check stopping criteria
+      if( norm2(temp_grad) < p.residual || step < p.step_length)
+        exit = true;
+
+      else if(stop && stop(x))
+        stopped = true;
+
+      else{
+        // select strategy to decay alpha
+        alpha = decay<strategy>(p, x, k, grad, f, w);
+
+        // update value of d = nu * d - alpha * grad
+        grad(x, temp_grad);
+        axpby(d, p.nu, d, -alpha, temp_grad);
+
+      }
+    }
+
+    return make_result(x, norm2(temp_grad), step, k, exit, stopped, f);
+  }
+};
+
+template<int strategy>
+struct nesterov{
+  static constexpr bool armijo = false;
+
+  static result minimize(const parameters &p, const gradient_wrapper & grad, const function_wrapper & f, const stop_function & stop) {
+    /**
+     *  @brief Nesterov accelerated gradient descent algorithm
+     *  @note All the vectors are allocated before the loop, which updates them in place
+     *  @param p: parameters
+     *  @param stop: function to stop the method in x, can be empty
+     *  @return result of the method
+     */
+
+    // x_old = x_{k-1}
+    // x = x_k
+    // x_new = x_{k+1}, written in the buffer of x_old
+
+    int k = 0;
+    bool exit = false, stopped = false;
+    format alpha = p.alpha_0;
+    size_type x_size = p.x0.size();
+    vector x_old(p.x0), temp_grad(x_size);
+    vector x(x_size), x_diff(x_size), y(x_size);
+    workspace w(x_size);
+    format step = 0;
+    grad(x_old, temp_grad);
+
+    // Calculate x_1
+    axpby(x, 1, x_old, -alpha, temp_grad);
+
+    while(!exit and !stopped and k < p.max_iter) {
+      ++k;
+
+      //set stopping condition variables
+      step = axpby(x_diff, 1, x, -1, x_old);
+      grad(x, temp_grad);
+
+      // Check stopping criteria
+      if(norm2(temp_grad) < p.residual || step < p.step_length) {
+        exit = true;
+      }
+      else if(stop && stop(x)) {
+        stopped = true;
+      }
+      else{
+        // select strategy to decay alpha
+        alpha = decay<strategy>(p, x, k, grad, f, w);
+
+        // Calculate y
+        axpby(y, 1, x, p.nu, x_diff);
+
+        // Calculate x_new, then x_old = x and x = x_new
+        grad(y, temp_grad);
+        axpby(x_old, 1, y, -alpha, temp_grad);
+        std::swap(x, x_old);
+      }
+    }
+
+    return make_result(x, norm2(temp_grad), step, k, exit, stopped, f);
+  }
+};
+
+bool strong_wolfe(const parameters & p, const vector & x, const vector & d, const format f_x, const format dphi_0,
+                  format & alpha, format & f_trial, vector & x_trial, vector & g_trial,
+                  const gradient_wrapper & grad, const function_wrapper & f){
+  /**
+   *  @brief Line search along d which satisfies the strong Wolfe conditions
+   *  @note Algorithms 3.5 and 3.6 of Nocedal and Wright: alpha is doubled until the interval [alpha_lo, alpha_hi]
+   *  contains a point which satisfies the conditions, then the interval is reduced with the minimum of the quadratic
+   *  through phi(alpha_lo), phi'(alpha_lo) and phi(alpha_hi), with phi(alpha) = f(x + alpha * d); the gradient is
+   *  computed only in the points which satisfy the sufficient decrease
+   *  @param p: parameters, c1 and c2 are the constants of the conditions
+   *  @param x: starting point
+   *  @param d: descent direction
+   *  @param f_x: value of f in x
+   *  @param dphi_0: derivative of phi in 0, grad f(x) * d < 0
+   *  @param alpha: first step to try, then the step found
+   *  @param f_trial: value of f in x + alpha * d
+   *  @param x_trial: x + alpha * d, of the same size of x
+   *  @param g_trial: gradient in x + alpha * d, of the same size of x
+   *  @return true if a step was found in line_search_iter evaluations
+   */
+
+  int evaluations = 0;
+  auto phi = [&](const format a){
+    ++evaluations;
+    axpby(x_trial, 1, x, a, d);
+    return f(x_trial);
+  };
+  // derivative in the last point of phi
+  auto dphi = [&](){
+    grad(x_trial, g_trial);
+    return dot(g_trial, d);
+  };
+  auto accept = [&](const format a, const format phi_a){
+    alpha = a;
+    f_trial = phi_a;
+    return true;
+  };
+
+  auto zoom = [&](format lo, format phi_lo, format dphi_lo, format hi, format phi_hi){
+    while(evaluations < p.line_search_iter){
+      // minimum of the quadratic, with bisection when it is not convex or too near to the extremes
+      const format width = hi - lo, den = 2 * (phi_hi - phi_lo - dphi_lo * width);
+      format a = den > 0 ? lo - dphi_lo * width * width / den : lo + width / 2;
+      if(std::abs(a - lo) < 0.1 * std::abs(width) || std::abs(hi - a) < 0.1 * std::abs(width))
+        a = lo + width / 2;
+
+      const format phi_a = phi(a);
+      if(phi_a > f_x + p.c1 * a * dphi_0 || phi_a >= phi_lo){
+        hi = a;
+        phi_hi = phi_a;
+      }
+      else{
+        const format dphi_a = dphi();
+        if(std::abs(dphi_a) <= -p.c2 * dphi_0)
+          return accept(a, phi_a);
+        if(dphi_a * (hi - lo) >= 0){
+          hi = lo;
+          phi_hi = phi_lo;
+        }
+        lo = a;
+        phi_lo = phi_a;
+        dphi_lo = dphi_a;
+      }
+    }
+
+    // no point satisfies the curvature condition, lo still satisfies the sufficient decrease
+    if(lo > 0){
+      const format phi_lo_again = phi(lo);
+      dphi();
+      return accept(lo, phi_lo_again);
+    }
+    return false;
+  };
+
+  format a = alpha, a_prev = 0, phi_prev = f_x, dphi_prev = dphi_0;
+  while(evaluations < p.line_search_iter){
+    const format phi_a = phi(a);
+    if(phi_a > f_x + p.c1 * a * dphi_0 || (a_prev > 0 && phi_a >= phi_prev))
+      return zoom(a_prev, phi_prev, dphi_prev, a, phi_a);
+
+    const format dphi_a = dphi();
+    if(std::abs(dphi_a) <= -p.c2 * dphi_0)
+      return accept(a, phi_a);
+    if(dphi_a >= 0)
+      return zoom(a, phi_a, dphi_a, a_prev, phi_prev);
+
+    a_prev = a;
+    phi_prev = phi_a;
+    dphi_prev = dphi_a;
+    a *= 2;
+  }
+
+  return false;
+}
+
+struct lbfgs{
+  static result minimize(const parameters & p, const gradient_wrapper & grad, const function_wrapper & f, const stop_function & stop){
+    /**
+     *  @brief Limited-memory BFGS algorithm with the strong Wolfe line search
+     *  @note The last p.memory pairs s = x_{k+1} - x_k and y = grad_{k+1} - grad_k are stored in a ring buffer
+     *  allocated before the loop, and the direction is computed with the two-loop recursion, starting from
+     *  H_0 = (s * y) / (y * y) I; the first step is p.alpha_0, then 1
+     *  @param p: parameters
+     *  @param stop: function to stop the method in x, can be empty
+     *  @return result of the method
+     */
+
+    int k = 0;
+    bool exit = false, stopped = false;
+    const size_type x_size = p.x0.size();
+    const int m = std::max(p.memory, 1);
+
+    vector x(p.x0), temp_grad(x_size), d(x_size), x_trial(x_size), g_trial(x_size);
+    std::vector<vector> s(m, vector(x_size)), y(m, vector(x_size));
+    std::vector<format> rho(m), a(m);
+    // the newest pair is before head, stored pairs in the buffer
+    int head = 0, stored = 0;
+
+    grad(x, temp_grad);
+    format f_x = f(x), residual = norm2(temp_grad), step = 0;
+    exit = residual < p.residual;
+
+    while(!exit and !stopped and k < p.max_iter){
+      ++k;
+
+      // two-loop recursion, d = -H grad
+      d = temp_grad;
+      for(int i = 1; i <= stored; i++){
+        const int j = (head - i + m) % m;
+        a[j] = rho[j] * dot(s[j], d);
+        axpy(d, -a[j], y[j]);
+      }
+      if(stored > 0){
+        const int j = (head - 1 + m) % m;
+        axpby(d, dot(s[j], y[j]) / dot(y[j], y[j]), d, 0, d);
+      }
+      for(int i = stored; i >= 1; i--){
+        const int j = (head - i + m) % m;
+        const format b = rho[j] * dot(y[j], d);
+        axpy(d, a[j] - b, s[j]);
+      }
+      axpby(d, -1, d, 0, d);
+
+      // restart from the gradient if d is not a descent direction
+      format dphi_0 = dot(temp_grad, d);
+      if(dphi_0 >= 0){
+        stored = 0;
+        axpby(d, -1, temp_grad, 0, temp_grad);
+        dphi_0 = -residual * residual;
+      }
+
+      format alpha = stored > 0 ? 1 : p.alpha_0, f_trial = f_x;
+      if(!strong_wolfe(p, x, d, f_x, dphi_0, alpha, f_trial, x_trial, g_trial, grad, f))
+        break;
+
+      // store the new pair if it keeps H positive definite
+      step = axpby(s[head], 1, x_trial, -1, x);
+      axpby(y[head], 1, g_trial, -1, temp_grad);
+      const format sy = dot(s[head], y[head]);
+      if(sy > std::numeric_limits<format>::epsilon() * dot(y[head], y[head])){
+        rho[head] = 1 / sy;
+        head = (head + 1) % m;
+        stored = std::min(stored + 1, m);
+      }
+
+      std::swap(x, x_trial);
+      std::swap(temp_grad, g_trial);
+      f_x = f_trial;
+      residual = norm2(temp_grad);
+
+      // check stopping criteria
+      if(residual < p.residual || step < p.step_length)
+        exit = true;
+      else if(stop && stop(x))
+        stopped = true;
+    }
+
+    return make_result(x, residual, step, k, exit, stopped, f);
+  }
+};
+
+template<template<int> class method>
+result with_strategy(const parameters & p, const gradient_wrapper & grad, const function_wrapper & f, const stop_function & stop){
+  /**
+   *  @brief Run a first-order method with the strategy of p, chosen at runtime among the compile-time policies
+   *  @param p: parameters
+   *  @param stop: function to stop the method in x, can be empty
+   *  @return result of the method, with error if the strategy is wrong
+   */
+
+  switch (p.strategy) {
+  case 1:
+      return method<1>::minimize(p, grad, f, stop);
+  case 2:
+      return method<2>::minimize(p, grad, f, stop);
+  default:
+      if constexpr (method<3>::armijo)
+        return method<3>::minimize(p, grad, f, stop);
+
+      std::cerr << "\nWrong strategy" << std::endl;
+      result r;
+      r.error = true;
+      return r;
+  }
+}
+
+result gradient_descent(const parameters & p, const gradient_wrapper & grad, const function_wrapper & f, const stop_function & stop = {}){
+  /**
+   *  @brief Minimize f from p.x0 with the method of p.mode
+   *  @param p: parameters
+   *  @param grad: gradient of f
+   *  @param f: function to minimize
+   *  @param stop: function to stop the method in x, can be empty
+   *  @return result of the method
+   */
+
+  switch (p.mode) {
+  case 1:
+      return with_strategy<heavy_ball>(p, grad, f, stop);
+  case 2:
+      return with_strategy<nesterov>(p, grad, f, stop);
+  case 3:
+      return lbfgs::minimize(p, grad, f, stop);
+  default:
+      return with_strategy<default_method>(p, grad, f, stop);
+  }
+}
+
+result run(const parameters & p, const stop_function & stop = {}){
+  /**
+   *  @brief Minimize the function of config.hpp, with new wrappers so the evaluations and the caches start from zero
+   *  @param p: parameters
+   *  @param stop: function to stop the method in x, can be empty
+   *  @return result of the method of p, with its time
+   */
+
+  const auto start = std::chrono::steady_clock::now();
+  function_wrapper wrap_f(function);
+  const gradient_wrapper wrap_grad = p.grad_mode == 0 ? gradient_wrapper(wrap_f, gradient) : gradient_wrapper(wrap_f, p.h, p.forward_difference, p.parallel_gradient);
+  result r = gradient_descent(p, wrap_grad, wrap_f, stop);
+  r.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return r;
+}
@@ -4,6 +4,10 @@
 #include <iomanip>
 #include <functional>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "config.hpp"
 
 format norm2(const vector & x){
@@ -12,107 +16,253 @@ format norm2(const vector & x){
    *  @return norm of the vector
    */
   format norm = 0;
-  for(auto & i : x)
-    norm += i*i;
+  for(size_type i = 0; i < x.size(); i++)
+    norm += x[i]*x[i];
   return std::sqrt(norm);
 }
 
-vector scalar_vector(vector & x, const format alpha){
-  /** @brief Scalar product of a vector
+format dot(const vector & x, const vector & y){
+  /** @brief Scalar product of two vectors
    *  @param x: vector
-   *  @param alpha: scalar
-   *  @return scalar product
+   *  @param y: vector
+   *  @return scalar product of x and y
    */
-  for(auto & i : x)
-    i *= alpha;
-  return x;
+  format sum = 0;
+  for(size_type i = 0; i < x.size(); i++)
+    sum += x[i]*y[i];
+  return sum;
 }
 
-vector subtraction_vector(const vector & x1, const vector & x2){
-  /** @brief Subtraction of two vectors
-   *  @param x1: vector
-   *  @param x2: vector to subtract
-   *  @return subtraction of the two vectors
+format distance(const vector & x, const vector & y){
+  /** @brief Distance between two points, without a vector for x - y
+   *  @param x: vector
+   *  @param y: vector
+   *  @return norm of x - y
    */
-  vector temp(x1.size());
-  for(size_t i = 0; i < x1.size(); i++)
-    temp[i] = x1[i] - x2[i];
-  return temp;
-
+  format sum = 0;
+  for(size_type i = 0; i < x.size(); i++)
+    sum += (x[i] - y[i])*(x[i] - y[i]);
+  return std::sqrt(sum);
 }
 
-vector sum_vector(const vector & x1, const vector & x2){
-  /** @brief Sum of two vectors
-   *  @param x1: vector
-   *  @param x2: vector to subtract
-   *  @return element-wise sum of the two vectors
+format axpy(vector & y, const format alpha, const vector & x){
+  /** @brief In-place update y = y + alpha * x
+   *  @param y: vector to update
+   *  @param alpha: scalar
+   *  @param x: vector
+   *  @return norm of alpha * x, the step added to y, computed in the same loop
    */
-  vector temp(x1.size());
-  for(size_t i = 0; i < x1.size(); i++)
-    temp[i] = x1[i] + x2[i];
-  return temp;
+  format norm = 0;
+  for(size_type i = 0; i < y.size(); i++){
+    const format step = alpha * x[i];
+    y[i] += step;
+    norm += step*step;
+  }
+  return std::sqrt(norm);
 }
 
-vector grad_approx(const vector& x, std::function<format(const vector &)> f, format h = 1e-6) {
-    /**
-     * @brief Approximate the gradient of a function using finite differences
-     * @param x: point where to compute the gradient
-     * @param f: function to differentiate
-     * @param h: step size
-     * @return gradient of the function at x
-    */
+format axpby(vector & z, const format alpha, const vector & x, const format beta, const vector & y){
+  /** @brief Linear combination z = alpha * x + beta * y in a preallocated vector
+   *  @note z can be x or y, each element is read before it is written
+   *  @param z: result, of the same size of x and y
+   *  @param alpha: scalar of x
+   *  @param x: vector
+   *  @param beta: scalar of y
+   *  @param y: vector
+   *  @return norm of z, computed in the same loop
+   */
+  format norm = 0;
+  for(size_type i = 0; i < z.size(); i++){
+    z[i] = alpha * x[i] + beta * y[i];
+    norm += z[i]*z[i];
+  }
+  return std::sqrt(norm);
+}
 
-    vector grad(x.size());
-    for (size_t i = 0; i < x.size(); ++i) {
-        vector x_plus_h = x;
-        vector x_minus_h = x;
-        x_plus_h[i] += h;
-        x_minus_h[i] -= h;
-        grad[i] = (f(x_plus_h) - f(x_minus_h)) / (2 * h);
-    }
-    return grad;
+bool same_point(const vector & x, const vector & y){
+  /** @brief Check if two vectors are the same point
+   *  @param x: vector
+   *  @param y: vector
+   *  @return true if x and y have the same size and the same elements
+   */
+  if(x.size() != y.size())
+    return false;
+  for(size_type i = 0; i < x.size(); i++)
+    if(x[i] != y[i])
+      return false;
+  return true;
 }
 
 // Function wrapper
 struct function_wrapper{
     /**
      * @brief Function to be minimized wrapper
+     * @note The value in the last point is cached, so the line search and the stopping criteria which evaluate f in
+     * the same point of the caller do not call the function again
     */
     std::function<format(const vector & x)> func;
 
+    // calls of func, also the ones of the approximate gradient
+    mutable size_t evaluations = 0;
+
+    // last point evaluated and its value
+    mutable vector x_cached;
+    mutable format f_cached = 0;
+    mutable bool cached = false;
+
     function_wrapper(std::function<format(const vector & x)> f): func(f){}
 
     format operator()(const vector & x) const{
-        return func(x);
+        if(!cached || !same_point(x, x_cached)){
+          f_cached = func(x);
+          x_cached = x;
+          cached = true;
+          ++evaluations;
+        }
+        return f_cached;
     }
 };
 
+void grad_approx(const vector & x, const function_wrapper & f, const format h, const bool forward, const bool parallel, vector & grad, std::vector<vector> & points) {
+    /**
+     * @brief Approximate the gradient of a function using finite differences
+     * @note The coordinates are split among the OpenMP threads, each one moves the coordinates of its own copy of x
+     * by +h and -h and then restores them; the function must be safe to call from more threads. Forward differences
+     * need the value in x, which usually is in the cache of f, and one call for each coordinate instead of two
+     * @param x: point where to compute the gradient
+     * @param f: function to differentiate
+     * @param h: step size
+     * @param forward: true for forward differences (f(x + h) - f(x)) / h, false for central differences
+     * @param parallel: false to compute the coordinates in the thread of the caller, which can already be one of many
+     * @param grad: gradient of the function at x, of the same size of x
+     * @param points: buffers for the moved points, one for each thread, allocated by the first call
+    */
+
+    #ifdef _OPENMP
+      const size_t threads = parallel ? omp_get_max_threads() : 1;
+    #else
+      const size_t threads = 1;
+    #endif
+    points.resize(threads);
+    for(auto & x_h : points)
+      x_h = x;
+
+    const format f_x = forward ? f(x) : 0;
+    const long n = x.size();
+
+    #pragma omp parallel for schedule(dynamic) if(parallel)
+    for (long i = 0; i < n; ++i) {
+        #ifdef _OPENMP
+          vector & x_h = points[parallel ? omp_get_thread_num() : 0];
+        #else
+          vector & x_h = points[0];
+        #endif
+
+        x_h[i] = x[i] + h;
+        const format f_plus_h = f.func(x_h);
+        if(forward)
+          grad[i] = (f_plus_h - f_x) / h;
+        else{
+          x_h[i] = x[i] - h;
+          const format f_minus_h = f.func(x_h);
+          grad[i] = (f_plus_h - f_minus_h) / (2 * h);
+        }
+        x_h[i] = x[i];
+    }
+
+    f.evaluations += forward ? n : 2 * n;
+}
+
 // Gradient wrapper
 struct gradient_wrapper{
     /**
      * @brief Gradient of the function to be minimized wrapper
+     * @note The gradient is written in a vector of the caller, so the loop of the gradient descent does not allocate;
+     * the gradient in the last point is cached like the value of the function wrapper
     */
-    #if grad_mode == 0
-        std::function<vector(const vector & x)> grad;
 
-        gradient_wrapper(std::function<vector(const vector & x)> g): grad(g){}
+    // defined gradient, empty to approximate it with finite differences of f
+    std::function<void(const vector & x, vector & grad)> grad;
+    const function_wrapper & f;
+    format h = 1e-6;
+    bool forward = false;
+    bool parallel = true;
+    // buffers of the moved points, one for each thread
+    mutable std::vector<vector> points;
 
-        vector operator()(const vector & x) const{
-          return grad(x);
-        }
-    #else
-        std::function<format(const vector & x)> f;
-        format h;
+    gradient_wrapper(const function_wrapper & func, std::function<void(const vector & x, vector & grad)> g): grad(g), f(func){}
 
-        gradient_wrapper(std::function<format(const vector & x)> g, format step = 1e-6): f(g), h(step){}
+    gradient_wrapper(const function_wrapper & func, format step = 1e-6, bool forward_difference = false, bool parallel_gradient = true): f(func), h(step), forward(forward_difference), parallel(parallel_gradient){}
 
-        vector operator()(const vector & x) const {
-          return grad_approx(x, f, h);
-        }
+    // last point and its gradient
+    mutable vector x_cached, grad_cached;
+    mutable bool cached = false;
 
-    #endif
+    void operator()(const vector & x, vector & g) const{
+      if(cached && same_point(x, x_cached)){
+        g = grad_cached;
+        return;
+      }
+
+      if(grad)
+        grad(x, g);
+      else
+        grad_approx(x, f, h, forward, parallel, g, points);
+
+      x_cached = x;
+      grad_cached = g;
+      cached = true;
+    }
+};
+
+// Buffers of the line search
+struct workspace{
+    /**
+     * @brief Vectors used by the line search, allocated once before the loop of the gradient descent
+    */
+    vector grad, x;
+
+    workspace(const size_type n): grad(n), x(n){}
 };
 
+// Result of a minimization
+struct result{
+    /**
+     * @brief Point found by a method with the values of the stopping criteria
+    */
+    vector x;
+    format value = 0;
+    format residual = 0;
+    format step = 0;
+    int iterations = 0;
+    size_t evaluations = 0;
+    // the stopping criteria were satisfied before max_iter
+    bool converged = false;
+    // the stop function of the caller stopped the method
+    bool stopped = false;
+    // time of the minimization, in milliseconds
+    double time = 0;
+    // wrong parameters, there is no result
+    bool error = false;
+};
+
+const char * method_name(const int mode){
+  /** @brief Name of a method
+   *  @param mode: method, as in parameters
+   *  @return name of the method
+   */
+  switch(mode){
+  case 1:
+    return "Heavy Ball";
+  case 2:
+    return "Nesterov";
+  case 3:
+    return "L-BFGS";
+  default:
+    return "Default";
+  }
+}
+
 void display_parameters(const parameters& p) {
   std::cout << "\n++++++++++++++++++++++++++++++++++++" << std::endl;
   std::cout << "++++++++++++ PARAMETERS ++++++++++++" << std::endl;
@@ -135,36 +285,36 @@ void display_parameters(const parameters& p) {
 
   std::cout << "------------------------------------" << std::endl;
   std::cout << "- Strategy:" << std::setw(17) << p.strategy << std::endl;
-  std::cout << "- Mode: ";
-  if(mode == 1)
-    std::cout << std::setw(29) << "Heavy Ball" << std::endl;
-  else if(mode == 2)
-    std::cout << std::setw(27)<<"Nesterov" << std::endl;
-  else
-    std::cout << std::setw(26) << "Default" << std::endl;
+  std::cout << "- Mode: " << std::setw(28) << method_name(p.mode) << std::endl;
+  if(p.mode == 3)
+    std::cout << "- Memory:" << std::setw(21) << p.memory << std::endl;
 
   std::cout << "- gradient mode: ";
-  if (grad_mode == 0)
+  if (p.grad_mode == 0)
     std::cout << std::setw(17) << "Defined" << std::endl;
+  else if (p.forward_difference)
+    std::cout << std::setw(17) << "Forward" << std::endl;
   else
-    std::cout << std::setw(21) << "Approximate" << std::endl;
+    std::cout << std::setw(17) << "Central" << std::endl;
 }
 
-void display_result(const vector & x, const vector & temp_grad, const vector & x_diff, const int k, std::function<format(const vector &)> f){
+void display_result(const result & r){
   std::cout << "\n++++++++++++++++++++++++++++++++++++" << std::endl;
   std::cout << "++++++++++++ NERD STATS ++++++++++++" << std::endl;
   std::cout << "++++++++++++++++++++++++++++++++++++\n" << std::endl;
-  std::cout << "- Iteration done: " << k << std::endl;
-  std::cout << "- Residual: " << norm2(temp_grad) << std::endl;
+  std::cout << "- Iteration done: " << r.iterations << std::endl;
+  std::cout << "- Residual: " << r.residual << std::endl;
   
-  std::cout << "- Step: " << norm2(x_diff) << std::endl;
+  std::cout << "- Step: " << r.step << std::endl;
+  std::cout << "- Function evaluations: " << r.evaluations << std::endl;
+  std::cout << "- Time: " << r.time << " ms" << std::endl;
 
   std::cout << "\n++++++++++++++++++++++++++++++++++++" << std::endl;
   std::cout << "++++++++++++++ RESULT ++++++++++++++" << std::endl;
   std::cout << "++++++++++++++++++++++++++++++++++++\n" << std::endl;
-  std::cout << "Minimum found in: " << f(x) <<std::endl;
+  std::cout << "Minimum found in: " << r.value <<std::endl;
   std::cout << "X = [ ";
-  for(auto & i : x)
+  for(auto & i : r.x)
     std::cout << i << " ";
   std::cout << "]" << std::endl;
-}
\ No newline at end of file
+}
@@ -0,0 +1,258 @@
+#include "Matrix.hpp"
+#include "SellMatrix.hpp"
+#include "BlockMatrix.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <optional>
+
+struct options
+{
+  int warmup = 2;
+  int runs = 10;
+  size_t vectors = 8;
+  std::string csv = "benchmark.csv";
+  std::vector<std::string> files;
+};
+
+struct result
+{
+  std::string matrix, order, format, kernel;
+  size_t rows, cols, nonzeros;
+  int runs;
+  double min, median, gflops, gbs;
+};
+
+template <typename Setup, typename Kernel>
+std::array<double, 2> measure(const options &opt, Setup &&setup, Kernel &&kernel)
+{
+  /**
+   * @brief function to time a kernel
+   * @note the kernel runs warmup times without timing, then runs times; setup runs before each call and is not timed
+   * @param opt the options of the benchmark
+   * @param setup the function which prepares each call of the kernel
+   * @param kernel the function to time
+   * @return the minimum and the median time, in milliseconds
+   */
+
+  for (int i = 0; i < opt.warmup; i++)
+  {
+    setup();
+    kernel();
+  }
+
+  std::vector<double> times(opt.runs);
+  for (auto &time : times)
+  {
+    setup();
+    auto start = std::chrono::steady_clock::now();
+    kernel();
+    auto stop = std::chrono::steady_clock::now();
+    time = std::chrono::duration<double, std::milli>(stop - start).count();
+  }
+
+  std::sort(times.begin(), times.end());
+  const size_t n = times.size();
+  return {times[0], n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2};
+}
+
+template <typename Kernel>
+std::array<double, 2> measure(const options &opt, Kernel &&kernel)
+{
+  return measure(opt, [] {}, kernel);
+}
+
+void record(std::vector<result> &results, const result &info, const std::string &kernel, const std::array<double, 2> &times,
+            const double &flops, const double &bytes)
+{
+  /**
+   * @brief function to save and print the result of a kernel
+   * @note GFLOP/s and GB/s are computed on the median time
+   * @param results the results of the benchmark
+   * @param info the matrix, storage order and format of the kernel
+   * @param kernel the name of the kernel
+   * @param times the minimum and the median time, in milliseconds
+   * @param flops the floating point operations of a call
+   * @param bytes the bytes read and written by a call
+   */
+
+  result r = info;
+  r.kernel = kernel;
+  r.min = times[0];
+  r.median = times[1];
+  r.gflops = flops / (times[1] * 1e6);
+  r.gbs = bytes / (times[1] * 1e6);
+  results.push_back(r);
+
+  std::cout << std::left << std::setw(12) << r.order << std::setw(12) << r.format << std::setw(14) << r.kernel << std::right
+            << std::setw(12) << std::fixed << std::setprecision(3) << r.min << std::setw(12) << r.median
+            << std::setw(10) << std::setprecision(2) << r.gflops << std::setw(10) << r.gbs << std::endl;
+}
+
+template <algebra::StorageOrder Order>
+size_t products(algebra::Matrix<double, Order> &m)
+{
+  /**
+   * @brief function to count the multiplications of the sparse product m * m
+   * @note the sum over k of the non-zeros of column k times the non-zeros of row k
+   * @param m the compressed square matrix
+   * @return the number of multiplications
+   */
+
+  std::vector<size_t> count1(m.get_rows(), 0), count2(m.get_rows(), 0);
+  m.update_values([&](const size_t &i, const size_t &j, const double &value)
+                  {
+                    std::atomic_ref<size_t>(count1[i]).fetch_add(1, std::memory_order_relaxed);
+                    std::atomic_ref<size_t>(count2[j]).fetch_add(1, std::memory_order_relaxed);
+                    return value; });
+  return std::inner_product(count1.begin(), count1.end(), count2.begin(), size_t(0));
+}
+
+template <algebra::StorageOrder Order>
+void benchmark_order(const options &opt, const std::string &file, std::vector<result> &results)
+{
+  /**
+   * @brief function to run the kernels on a matrix in a storage order
+   * @note read and compress, then the products and the norms of the compressed matrix; with RowMajor also the
+   * products of the SELL-C-sigma and BCSR formats
+   * @param opt the options of the benchmark
+   * @param file the Matrix Market file
+   * @param results the results of the benchmark
+   */
+
+  constexpr bool row_major = Order == algebra::StorageOrder::RowMajor;
+  const size_t idx = sizeof(size_t), val = sizeof(double);
+
+  std::optional<algebra::Matrix<double, Order>> m;
+  std::ifstream input(file, std::ios::binary | std::ios::ate);
+  const double file_size = input.tellg();
+  auto read = measure(opt, [&]
+                      { m.reset(); }, [&]
+                      { m.emplace(file); });
+
+  result info{file, row_major ? "RowMajor" : "ColumnMajor", "triplets", "", m->get_rows(), m->get_cols(), m->get_nonzeros(), opt.runs, 0, 0, 0, 0};
+  const size_t rows = info.rows, cols = info.cols, nnz = info.nonzeros;
+  record(results, info, "read", read, 0, file_size);
+
+  // each compression starts from a copy of the matrix read from the file, with its triplets
+  const algebra::Matrix<double, Order> uncompressed = *m;
+  auto compress = measure(opt, [&]
+                          { m.emplace(uncompressed); }, [&]
+                          { m->compress(); });
+  info.format = row_major ? "CSR" : "CSC";
+  record(results, info, "compress", compress, 0, nnz * (sizeof(algebra::Triplet<double>) + idx + val));
+
+  // bytes of the compressed arrays
+  const double matrix_bytes = nnz * (idx + val) + ((row_major ? rows : cols) + 1) * idx;
+
+  // the scratch of the products is kept between the runs, only the first one allocates it
+  algebra::ProductWorkspace<double> workspace;
+  std::vector<double> x(cols, 1), y(rows);
+  auto spmv = measure(opt, [&]
+                      { algebra::multiply(*m, std::span<const double>(x), std::span<double>(y), workspace); });
+  record(results, info, "SpMV", spmv, 2.0 * nnz, matrix_bytes + (rows + cols) * val);
+
+  const size_t k = opt.vectors;
+  std::vector<double> xk(cols * k, 1), yk(rows * k);
+  auto spmm = measure(opt, [&]
+                      { algebra::multiply(*m, std::span<const double>(xk), std::span<double>(yk), k, workspace); });
+  record(results, info, "SpMM-" + std::to_string(k), spmm, 2.0 * nnz * k, matrix_bytes + (rows + cols) * k * val);
+
+  if (rows == cols)
+  {
+    size_t nnz_result = 0;
+    auto spgemm = measure(opt, [&]
+                          { nnz_result = ((*m) * (*m)).get_nonzeros(); });
+    record(results, info, "SpGEMM", spgemm, 2.0 * products(*m), 2 * matrix_bytes + nnz_result * (idx + val));
+  }
+
+  double norm = 0;
+  auto one = measure(opt, [&]
+                     { norm += m->template norm<algebra::norm_type::One>(); });
+  record(results, info, "norm-One", one, nnz, matrix_bytes);
+  auto infinity = measure(opt, [&]
+                          { norm += m->template norm<algebra::norm_type::Infinity>(); });
+  record(results, info, "norm-Infinity", infinity, nnz, matrix_bytes);
+  auto frobenius = measure(opt, [&]
+                           { norm += m->template norm<algebra::norm_type::Frobenius>(); });
+  record(results, info, "norm-Frob", frobenius, 2.0 * nnz, nnz * val);
+
+  // the other formats are built from the CSR matrix, their column indexes are 32 bits
+  if constexpr (row_major)
+  {
+    const algebra::SellMatrix<double> sell(*m);
+    info.format = "SELL-8-256";
+    auto sell_spmv = measure(opt, [&]
+                             { sell.multiply(x, y); });
+    record(results, info, "SpMV", sell_spmv, 2.0 * nnz,
+           sell.fill_ratio() * nnz * (sizeof(std::uint32_t) + val) + (rows + cols) * val + rows * sizeof(std::uint32_t));
+
+    const algebra::BlockMatrix<double> block(*m);
+    info.format = "BCSR-2x2";
+    auto block_spmv = measure(opt, [&]
+                              { block.multiply(x, y); });
+    record(results, info, "SpMV", block_spmv, 2.0 * nnz,
+           block.fill_ratio() * nnz * val + block.fill_ratio() * nnz / 4 * sizeof(std::uint32_t) + (rows + cols) * val);
+  }
+}
+
+void write_csv(const std::vector<result> &results, const std::string &filename)
+{
+  /**
+   * @brief function to write the results in a CSV file, one line for each kernel
+   * @param results the results of the benchmark
+   * @param filename the name of the file
+   */
+
+  std::ofstream csv(filename);
+  if (!csv)
+    throw std::runtime_error("[write_csv] Cannot open " + filename);
+
+  csv << "matrix,rows,cols,nonzeros,order,format,kernel,runs,min_ms,median_ms,gflops,gbs" << std::endl;
+  for (const auto &r : results)
+    csv << r.matrix << "," << r.rows << "," << r.cols << "," << r.nonzeros << "," << r.order << "," << r.format << "," << r.kernel << ","
+        << r.runs << "," << r.min << "," << r.median << "," << r.gflops << "," << r.gbs << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  options opt;
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string arg = argv[i];
+    if (arg.rfind("--warmup=", 0) == 0)
+      opt.warmup = std::stoi(arg.substr(9));
+    else if (arg.rfind("--runs=", 0) == 0)
+      opt.runs = std::stoi(arg.substr(7));
+    else if (arg.rfind("--vectors=", 0) == 0)
+      opt.vectors = std::stoul(arg.substr(10));
+    else if (arg.rfind("--csv=", 0) == 0)
+      opt.csv = arg.substr(6);
+    else
+      opt.files.push_back(arg);
+  }
+
+  if (opt.files.empty() || opt.runs < 1 || opt.warmup < 0 || opt.vectors < 1)
+  {
+    std::cout << "Usage: ./benchmark [--warmup=2] [--runs=10] [--vectors=8] [--csv=benchmark.csv] <matrix 1.mtx> [<matrix 2.mtx> ...]" << std::endl;
+    return 1;
+  }
+
+  std::vector<result> results;
+  for (const auto &file : opt.files)
+  {
+    std::cout << std::endl
+              << file << " (" << opt.warmup << " warmup, " << opt.runs << " runs, times in ms)" << std::endl;
+    std::cout << std::left << std::setw(12) << "Order" << std::setw(12) << "Format" << std::setw(14) << "Kernel" << std::right
+              << std::setw(12) << "Min" << std::setw(12) << "Median" << std::setw(10) << "GFLOP/s" << std::setw(10) << "GB/s" << std::endl;
+
+    benchmark_order<algebra::StorageOrder::RowMajor>(opt, file, results);
+    benchmark_order<algebra::StorageOrder::ColumnMajor>(opt, file, results);
+  }
+
+  write_csv(results, opt.csv);
+  std::cout << std::endl
+            << "Results written in " << opt.csv << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,178 @@
+#ifndef BLOCK_MATRIX_HPP
+#define BLOCK_MATRIX_HPP
+
+#include "Matrix.hpp"
+
+namespace algebra
+{
+
+    template <typename T, size_t R = 2, size_t B = 2, typename Index = std::uint32_t>
+    class BlockMatrix
+    {
+        /**
+         * @brief Sparse matrix in Block Compressed Sparse Row (BCSR) format
+         * @note The matrix is split in dense blocks of R x B values and the non-zero blocks are stored like a CSR matrix
+         * of blocks, each one row by row: one column index of type Index (32 bits by default) every R x B values, and the
+         * product of a block is a small dense kernel unrolled by the compiler
+         */
+
+        static_assert(R > 0 && B > 0, "[BlockMatrix] The blocks must not be empty");
+        static_assert(std::is_unsigned_v<Index>, "[BlockMatrix] Index must be an unsigned type");
+
+    private:
+        size_t rows = 0, cols = 0, nonzeros = 0;
+
+        std::vector<size_t> inner_idx; // first block of each row of blocks, the last one is the number of blocks
+        std::vector<Index> outer_idx;  // column of blocks of each block
+        std::vector<T> data;           // R x B values of each block
+        std::vector<size_t> bounds;    // blocks of rows of blocks with about the same number of blocks, one for each thread
+
+    public:
+        template <StorageOrder Order>
+        explicit BlockMatrix(const Matrix<T, Order> &m)
+        {
+            /**
+             * @brief Constructor for the BlockMatrix class
+             * @note The matrix is converted from its CSR format, the values of a block which are not in the matrix are 0
+             * @param m The matrix, in any storage order, compressed or not
+             */
+
+            if (m.get_cols() / B > std::numeric_limits<Index>::max())
+                throw std::invalid_argument("[BlockMatrix] The dimensions of the matrix do not fit in the index type");
+
+            CompressedMatrix<T> storage;
+            const CompressedMatrix<T> &csr = m.row_compressed(storage);
+            rows = m.get_rows();
+            cols = m.get_cols();
+            nonzeros = csr.outer_idx.size();
+
+            const size_t block_rows = (rows + R - 1) / R, block_cols = (cols + B - 1) / B;
+            constexpr size_t none = std::numeric_limits<size_t>::max();
+
+            // position of each column of blocks in the current row of blocks
+            std::vector<size_t> position(block_cols, none);
+            inner_idx.assign(block_rows + 1, 0);
+            for (size_t br = 0; br < block_rows; ++br)
+            {
+                const size_t first = outer_idx.size();
+                for (size_t r = br * R; r < std::min(rows, (br + 1) * R); ++r)
+                {
+                    for (size_t j = csr.inner_idx[r]; j < csr.inner_idx[r + 1]; ++j)
+                    {
+                        const size_t bc = csr.outer_idx[j] / B;
+                        if (position[bc] == none)
+                        {
+                            position[bc] = 0;
+                            outer_idx.push_back(bc);
+                        }
+                    }
+                }
+
+                std::sort(outer_idx.begin() + first, outer_idx.end());
+                data.resize(outer_idx.size() * R * B, 0);
+                for (size_t k = first; k < outer_idx.size(); ++k)
+                    position[outer_idx[k]] = k;
+
+                for (size_t r = br * R; r < std::min(rows, (br + 1) * R); ++r)
+                {
+                    for (size_t j = csr.inner_idx[r]; j < csr.inner_idx[r + 1]; ++j)
+                    {
+                        const size_t c = csr.outer_idx[j];
+                        data[position[c / B] * R * B + (r - br * R) * B + c % B] += csr.data[j];
+                    }
+                }
+
+                for (size_t k = first; k < outer_idx.size(); ++k)
+                    position[outer_idx[k]] = none;
+                inner_idx[br + 1] = outer_idx.size();
+            }
+
+            bounds = balanced_partition(inner_idx, (1 << 15) / (R * B) + 1);
+        }
+
+        size_t get_rows() const noexcept { return rows; }
+        size_t get_cols() const noexcept { return cols; }
+        size_t get_nonzeros() const noexcept { return nonzeros; }
+        // stored values over non-zeros, 1 when the blocks are full
+        double fill_ratio() const noexcept { return nonzeros ? static_cast<double>(data.size()) / nonzeros : 1; }
+
+        void multiply(std::span<const T> x, std::span<T> y) const
+        {
+            /**
+             * @brief Multiply the matrix by a vector, writing the result in a buffer of the caller
+             * @note The rows of blocks are split in blocks with the same number of blocks, computed by the constructor, which run
+             * in parallel; the blocks on the last columns, when B does not divide them, check the columns which are outside
+             * the matrix
+             * @param x The vector, of size the number of columns
+             * @param y The result, of size the number of rows
+             */
+
+            if (x.size() != cols || y.size() != rows)
+                throw std::invalid_argument("[BlockMatrix::multiply] The sizes of the vectors must be the number of columns and rows of the matrix");
+
+            const size_t full_cols = cols / B;
+            for_each_block(bounds.size() - 1, [&](const size_t &b)
+                           {
+                               for (size_t br = bounds[b]; br < bounds[b + 1]; ++br)
+                               {
+                                   T sum[R] = {};
+                                   for (size_t k = inner_idx[br]; k < inner_idx[br + 1]; ++k)
+                                   {
+                                       const T *block = data.data() + k * R * B;
+                                       const size_t c0 = static_cast<size_t>(outer_idx[k]) * B;
+                                       if (outer_idx[k] < full_cols)
+                                       {
+                                           for (size_t r = 0; r < R; ++r)
+                                           {
+                                               T row_sum = 0;
+                                               #pragma omp simd reduction(+ : row_sum)
+                                               for (size_t c = 0; c < B; ++c)
+                                                   row_sum += block[r * B + c] * x[c0 + c];
+                                               sum[r] += row_sum;
+                                           }
+                                       }
+                                       else
+                                       {
+                                           for (size_t r = 0; r < R; ++r)
+                                               for (size_t c = 0; c0 + c < cols; ++c)
+                                                   sum[r] += block[r * B + c] * x[c0 + c];
+                                       }
+                                   }
+
+                                   for (size_t r = 0; r < R && br * R + r < rows; ++r)
+                                       y[br * R + r] = sum[r];
+                               } });
+        }
+    };
+
+    template <typename T, size_t R, size_t B, typename Index>
+    void multiply(const BlockMatrix<T, R, B, Index> &m, std::span<const T> x, std::span<T> y)
+    {
+        /**
+         * @brief Multiply a matrix in BCSR format by a vector, writing the result in a buffer of the caller
+         * @param m The matrix
+         * @param x The vector
+         * @param y The result
+         */
+
+        m.multiply(x, y);
+    }
+
+    template <typename T, size_t R, size_t B, typename Index>
+    std::vector<T> operator*(const BlockMatrix<T, R, B, Index> &m, const std::vector<T> &v)
+    {
+        /**
+         * @brief Multiply a matrix in BCSR format by a vector
+         * @param m The matrix
+         * @param v The vector
+         * @return The result of the multiplication
+         */
+
+        std::vector<T> result(m.get_rows(), 0);
+        m.multiply(v, result);
+        return result;
+    }
+
+}
+
+#endif
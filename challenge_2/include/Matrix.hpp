@@ -6,12 +6,27 @@
 #include <iostream>
 #include <vector>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <span>
+#include <thread>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include <fstream>
 #include <sstream>
 #include <numeric>
 #include <execution>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <ranges>
 
 #ifdef DEBUG
 #define DEBUG_MSG(msg) std::cout << msg << std::endl;
@@ -35,24 +50,584 @@ namespace algebra
         Frobenius,
     };
 
+    enum reordering_type
+    {
+        Natural,
+        RCM, // Reverse Cuthill-McKee
+    };
+
+    class MappedFile
+    {
+        /**
+         * @brief Private memory mapping of a whole file, unmapped by the destructor
+         * @note The pages are copy-on-write: they can be written, but the file is never changed
+         */
+
+        int fd = -1;
+        char *ptr = nullptr;
+        size_t length = 0;
+
+    public:
+        explicit MappedFile(const std::string &filename)
+        {
+            /**
+             * @brief Constructor for the MappedFile class
+             * @param filename The name of the file
+             */
+
+            fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd == -1)
+                throw std::runtime_error("file not found");
+
+            struct stat buffer;
+            if (fstat(fd, &buffer) == -1)
+            {
+                ::close(fd);
+                throw std::runtime_error("[MappedFile] Cannot read the size of " + filename);
+            }
+
+            length = buffer.st_size;
+            if (length == 0)
+                return;
+
+            void *address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("[MappedFile] Cannot map " + filename);
+            }
+
+            ptr = static_cast<char *>(address);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile()
+        {
+            if (ptr)
+                munmap(ptr, length);
+            if (fd != -1)
+                ::close(fd);
+        }
+
+        void advise(const int &advice) const noexcept
+        {
+            /**
+             * @brief Tell the kernel how the mapping will be read
+             * @param advice The advice of madvise, like MADV_SEQUENTIAL
+             */
+
+            if (ptr)
+                madvise(ptr, length, advice);
+        }
+
+        const char *data() const noexcept { return ptr; }
+        char *data() noexcept { return ptr; }
+        size_t size() const noexcept { return length; }
+    };
+
+    template <typename U>
+    class CompressedArray
+    {
+        /**
+         * @brief Array of the compressed matrix which owns its values or views them inside a mapped snapshot
+         * @note The interface is the one of the vector it replaces. Writing into a view changes only the private pages of
+         * the mapping, any change of size and any copy move the values into owned storage
+         */
+
+        std::vector<U> owned;
+        std::shared_ptr<MappedFile> file; // keeps the mapping alive while the view is used
+        U *ptr = nullptr;
+        size_t length = 0;
+
+        void own() noexcept
+        {
+            ptr = owned.data();
+            length = owned.size();
+        }
+
+        void copy_view()
+        {
+            if (!file)
+                return;
+
+            owned.assign(ptr, ptr + length);
+            file.reset();
+            own();
+        }
+
+    public:
+        CompressedArray() = default;
+        CompressedArray(const CompressedArray &other) : owned(other.begin(), other.end())
+        {
+            own();
+        }
+        CompressedArray(CompressedArray &&other) noexcept : owned(std::move(other.owned)), file(std::move(other.file)), ptr(other.ptr), length(other.length)
+        {
+            other.own();
+        }
+        CompressedArray &operator=(CompressedArray other) noexcept
+        {
+            owned.swap(other.owned);
+            file.swap(other.file);
+            std::swap(ptr, other.ptr);
+            std::swap(length, other.length);
+            return *this;
+        }
+
+        void view(std::shared_ptr<MappedFile> mapping, U *values, const size_t &n)
+        {
+            /**
+             * @brief View n values inside a mapped file, without copying them
+             * @param mapping The mapped file
+             * @param values The first value, inside the mapping
+             * @param n The number of values
+             */
+
+            owned.clear();
+            owned.shrink_to_fit();
+            file = std::move(mapping);
+            ptr = values;
+            length = n;
+        }
+
+        bool is_view() const noexcept { return file != nullptr; }
+        size_t size() const noexcept { return length; }
+        bool empty() const noexcept { return length == 0; }
+        const U *data() const noexcept { return ptr; }
+        const U *begin() const noexcept { return ptr; }
+        const U *end() const noexcept { return ptr + length; }
+        const U &back() const noexcept { return ptr[length - 1]; }
+        const U &operator[](const size_t &i) const noexcept { return ptr[i]; }
+
+        U *begin() noexcept { return ptr; }
+        U *end() noexcept { return ptr + length; }
+        U &operator[](const size_t &i) noexcept { return ptr[i]; }
+
+        void resize(const size_t &n, const U &value = U())
+        {
+            copy_view();
+            owned.resize(n, value);
+            own();
+        }
+        void assign(const size_t &n, const U &value)
+        {
+            file.reset();
+            owned.assign(n, value);
+            own();
+        }
+        void reserve(const size_t &n)
+        {
+            copy_view();
+            owned.reserve(n);
+            own();
+        }
+        template <typename... Args>
+        void emplace_back(Args &&...args)
+        {
+            copy_view();
+            owned.emplace_back(std::forward<Args>(args)...);
+            own();
+        }
+        void clear() noexcept
+        {
+            file.reset();
+            owned.clear();
+            own();
+        }
+    };
+
+    template <typename T>
+    struct Triplet
+    {
+        std::array<std::size_t, 2> idx;
+        T value;
+    };
+
     template <typename T>
     struct CompressedMatrix
     {
-        std::vector<size_t> inner_idx;
-        std::vector<size_t> outer_idx;
-        std::vector<T> data;
+        CompressedArray<size_t> inner_idx;
+        CompressedArray<size_t> outer_idx;
+        CompressedArray<T> data;
+    };
+
+    struct SnapshotHeader
+    {
+        /**
+         * @brief Header of the binary snapshot of a compressed matrix
+         * @note The header is followed by inner_idx, outer_idx and data at the given offsets, aligned to 64 bytes,
+         * in the byte order of the machine which wrote them (checked through endian); a reordered matrix has its
+         * permutation and the inverse one after them (n_perm is 0 otherwise)
+         */
+
+        static constexpr char magic_value[8] = {'A', 'L', 'G', 'C', 'S', 'R', '\0', '\0'};
+        static constexpr std::uint32_t current_version = 2;
+        static constexpr std::uint32_t endian_value = 0x01020304;
+
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t endian;
+        std::uint32_t order;
+        std::uint32_t index_size;
+        std::uint32_t value_size;
+        std::uint32_t value_floating;
+        std::uint64_t rows, cols;
+        std::uint64_t n_inner, n_outer;
+        std::uint64_t inner_offset, outer_offset, data_offset;
+        std::uint64_t n_perm, perm_offset, inverse_offset;
+    };
+
+    template <typename T>
+    class DenseMatrix
+    {
+        /**
+         * @brief Dense matrix stored row by row, used as a block of vectors (one for each column) in the products
+         */
+
+        size_t rows = 0, cols = 0;
+        std::vector<T> values;
+
+    public:
+        DenseMatrix(const size_t &n_rows, const size_t &n_cols, const T &value = 0) : rows(n_rows), cols(n_cols), values(n_rows * n_cols, value) {}
+
+        T &operator()(const size_t &row, const size_t &col) noexcept { return values[row * cols + col]; }
+        const T &operator()(const size_t &row, const size_t &col) const noexcept { return values[row * cols + col]; }
+
+        std::span<T> data() noexcept { return values; }
+        std::span<const T> data() const noexcept { return values; }
+        size_t get_rows() const noexcept { return rows; }
+        size_t get_cols() const noexcept { return cols; }
+    };
+
+    template <typename T>
+    struct ProductWorkspace
+    {
+        /**
+         * @brief Scratch of the products of a compressed matrix by vectors, owned by the caller and reused by its products
+         * @note The accumulators of the blocks after the first one (CSC) and the permuted vectors of a reordered matrix grow
+         * in the first product which needs them, then the products allocate nothing. The matrix is only read, so it can be
+         * shared by many callers, each one with its own workspace
+         */
+
+        std::vector<std::vector<T>> partial;
+        std::vector<T> x_perm, y_perm;
+
+        static std::span<T> get(std::vector<T> &vector, const size_t &size)
+        {
+            /**
+             * @brief Get one of the scratch vectors
+             * @note It allocates only the first time, or when it grows
+             * @param vector The scratch vector
+             * @param size The number of elements
+             * @return The first size elements of the vector, not initialized
+             */
+
+            if (vector.size() < size)
+                vector.resize(size);
+            return std::span<T>(vector.data(), size);
+        }
     };
 
+    // other compressed layouts, built from a Matrix (SellMatrix.hpp, BlockMatrix.hpp)
+    template <typename T, size_t C, size_t Sigma, typename Index>
+    class SellMatrix;
+    template <typename T, size_t R, size_t B, typename Index>
+    class BlockMatrix;
+
+    // preconditioners of the iterative solvers, built from a Matrix (Solver.hpp)
+    template <typename T>
+    class JacobiPreconditioner;
+    template <typename T>
+    class ILU0Preconditioner;
+
+    inline size_t hardware_threads()
+    {
+        /**
+         * @brief The number of threads of the parallel kernels, one for each hardware thread
+         * @return The number of threads, at least 1
+         */
+
+        static const size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        return threads;
+    }
+
+    inline std::vector<size_t> balanced_partition(std::span<const size_t> prefix, const size_t &min_block)
+    {
+        /**
+         * @brief Split a range in contiguous blocks with about the same weight
+         * @note There is one block for each thread, but each one weighs at least min_block
+         * @param prefix The cumulative weights: prefix[i] is the weight of the elements before i, from 0 to the total
+         * @param min_block The minimum weight of a block
+         * @return The bounds of the blocks, the first is 0 and the last the number of elements
+         */
+
+        const size_t n = prefix.size() - 1;
+        const size_t total = prefix.back();
+        if (total < 2 * min_block)
+            return {0, n};
+
+        const size_t parts = std::min(hardware_threads(), total / min_block);
+
+        std::vector<size_t> bounds(parts + 1, n);
+        bounds[0] = 0;
+        for (size_t p = 1; p < parts; ++p)
+        {
+            // first element which starts after p parts of the weight
+            const size_t target = total / parts * p;
+            bounds[p] = std::lower_bound(prefix.begin(), prefix.end(), target) - prefix.begin();
+            bounds[p] = std::clamp(bounds[p], bounds[p - 1], n);
+        }
+
+        return bounds;
+    }
+
+    template <typename Kernel>
+    void for_each_block(const size_t &n_blocks, Kernel &&kernel)
+    {
+        /**
+         * @brief Run the kernel on each block in parallel
+         * @note A single block runs on the calling thread, without the overhead of the parallel algorithm. The indexes of the
+         * blocks come from a table built once, since the partitions have at most one block for each thread: the iterators of
+         * std::views::iota are not random access for the parallel algorithms, which would run them one after the other
+         * @param n_blocks The number of blocks
+         * @param kernel The function called with the index of each block
+         */
+
+        if (n_blocks == 1)
+        {
+            kernel(0);
+            return;
+        }
+
+        static const std::vector<size_t> blocks = []
+        {
+            std::vector<size_t> indexes(hardware_threads());
+            std::iota(indexes.begin(), indexes.end(), 0);
+            return indexes;
+        }();
+
+        if (n_blocks <= blocks.size())
+        {
+            std::for_each(std::execution::par, blocks.begin(), blocks.begin() + n_blocks, kernel);
+            return;
+        }
+
+        std::vector<size_t> more(n_blocks);
+        std::iota(more.begin(), more.end(), 0);
+        std::for_each(std::execution::par, more.begin(), more.end(), kernel);
+    }
+
+    template <typename T>
+    CompressedMatrix<T> transpose(const CompressedMatrix<T> &m, const size_t &n_minor)
+    {
+        /**
+         * @brief Swap the major and minor index of a compressed matrix (CSR to CSC and vice versa)
+         * @note A counting sort by the minor index, O(nnz): the minor indexes of the result are sorted
+         * @param m The compressed matrix
+         * @param n_minor The number of minor indexes (columns of a CSR matrix)
+         * @return The compressed matrix in the other order
+         */
+
+        CompressedMatrix<T> result;
+        result.inner_idx.assign(n_minor + 1, 0);
+        result.outer_idx.resize(m.outer_idx.size());
+        result.data.resize(m.data.size());
+
+        for (const auto &idx : m.outer_idx)
+            ++result.inner_idx[idx + 1];
+        std::partial_sum(result.inner_idx.begin(), result.inner_idx.end(), result.inner_idx.begin());
+
+        // next free position of each minor index
+        std::vector<size_t> next(result.inner_idx.begin(), result.inner_idx.end() - 1);
+        for (size_t i = 0; i + 1 < m.inner_idx.size(); ++i)
+        {
+            for (size_t j = m.inner_idx[i]; j < m.inner_idx[i + 1]; ++j)
+            {
+                const size_t pos = next[m.outer_idx[j]]++;
+                result.outer_idx[pos] = i;
+                result.data[pos] = m.data[j];
+            }
+        }
+
+        return result;
+    }
+
+    template <typename T>
+    CompressedMatrix<T> permute(const CompressedMatrix<T> &m, std::span<const size_t> from, std::span<const size_t> to)
+    {
+        /**
+         * @brief Renumber the major and minor indexes of a square compressed matrix
+         * @note The major index i of the result is the major index from[i] of m, and each minor index j becomes to[j];
+         * two transpositions (counting sorts) sort the minor indexes again, O(nnz)
+         * @param m The compressed matrix
+         * @param from The old index of each new index
+         * @param to The new index of each old index, the inverse of from
+         * @return The renumbered compressed matrix
+         */
+
+        const size_t n = from.size();
+        CompressedMatrix<T> result;
+        result.inner_idx.assign(n + 1, 0);
+        result.outer_idx.resize(m.outer_idx.size());
+        result.data.resize(m.data.size());
+
+        for (size_t i = 0; i < n; ++i)
+            result.inner_idx[i + 1] = result.inner_idx[i] + m.inner_idx[from[i] + 1] - m.inner_idx[from[i]];
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t pos = result.inner_idx[i];
+            for (size_t j = m.inner_idx[from[i]]; j < m.inner_idx[from[i] + 1]; ++j, ++pos)
+            {
+                result.outer_idx[pos] = to[m.outer_idx[j]];
+                result.data[pos] = m.data[j];
+            }
+        }
+
+        return transpose(transpose(result, n), n);
+    }
+
+    template <typename T>
+    std::vector<size_t> reverse_cuthill_mckee(const CompressedMatrix<T> &m)
+    {
+        /**
+         * @brief Reverse Cuthill-McKee ordering of a square compressed matrix, which reduces its bandwidth
+         * @note Breadth-first visit of the graph of the pattern of A + A^T, with the neighbours of each node in order of
+         * increasing degree, from a pseudo-peripheral node of each connected component (George-Liu); the order is
+         * reversed at the end. The minor indexes of each major one must be sorted
+         * @param m The compressed matrix
+         * @return The permutation: the element i is the old index of the new index i
+         */
+
+        const size_t n = m.inner_idx.size() - 1;
+        constexpr size_t none = std::numeric_limits<size_t>::max();
+
+        // graph of A + A^T without the diagonal: the sorted lists of a row and a column are merged
+        const CompressedMatrix<T> mt = transpose(m, n);
+        std::vector<size_t> adj_ptr(n + 1, 0), adj;
+        adj.reserve(2 * m.outer_idx.size());
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t a = m.inner_idx[i], b = mt.inner_idx[i];
+            while (a < m.inner_idx[i + 1] || b < mt.inner_idx[i + 1])
+            {
+                size_t next;
+                if (b == mt.inner_idx[i + 1] || (a < m.inner_idx[i + 1] && m.outer_idx[a] < mt.outer_idx[b]))
+                    next = m.outer_idx[a++];
+                else
+                {
+                    next = mt.outer_idx[b++];
+                    if (a < m.inner_idx[i + 1] && m.outer_idx[a] == next)
+                        ++a;
+                }
+                if (next != i)
+                    adj.push_back(next);
+            }
+            adj_ptr[i + 1] = adj.size();
+        }
+
+        auto degree = [&](const size_t &i)
+        { return adj_ptr[i + 1] - adj_ptr[i]; };
+
+        // breadth-first level structure from root: the nodes in visit order and their depth, returns the last depth
+        std::vector<size_t> depth(n, none), nodes;
+        auto levels = [&](const size_t &root)
+        {
+            for (const auto &node : nodes)
+                depth[node] = none;
+            nodes.assign(1, root);
+            depth[root] = 0;
+            for (size_t head = 0; head < nodes.size(); ++head)
+            {
+                const size_t u = nodes[head];
+                for (size_t j = adj_ptr[u]; j < adj_ptr[u + 1]; ++j)
+                {
+                    if (depth[adj[j]] == none)
+                    {
+                        depth[adj[j]] = depth[u] + 1;
+                        nodes.push_back(adj[j]);
+                    }
+                }
+            }
+            return depth[nodes.back()];
+        };
+
+        std::vector<size_t> order;
+        order.reserve(n);
+        std::vector<bool> visited(n, false);
+        std::vector<size_t> neighbours;
+        for (size_t seed = 0; seed < n; ++seed)
+        {
+            if (visited[seed])
+                continue;
+
+            // start from the node of minimum degree of the component, then move to a node of minimum degree of the
+            // last level while the number of levels grows
+            levels(seed);
+            size_t root = *std::min_element(nodes.begin(), nodes.end(), [&](const size_t &a, const size_t &b)
+                                            { return degree(a) < degree(b); });
+            size_t eccentricity = levels(root);
+            while (true)
+            {
+                size_t candidate = none;
+                for (const auto &node : nodes)
+                    if (depth[node] == eccentricity && (candidate == none || degree(node) < degree(candidate)))
+                        candidate = node;
+
+                const size_t candidate_eccentricity = levels(candidate);
+                if (candidate_eccentricity <= eccentricity)
+                    break;
+                root = candidate;
+                eccentricity = candidate_eccentricity;
+            }
+
+            // Cuthill-McKee visit of the component
+            const size_t first = order.size();
+            order.push_back(root);
+            visited[root] = true;
+            for (size_t head = first; head < order.size(); ++head)
+            {
+                const size_t u = order[head];
+                neighbours.clear();
+                for (size_t j = adj_ptr[u]; j < adj_ptr[u + 1]; ++j)
+                {
+                    if (!visited[adj[j]])
+                    {
+                        visited[adj[j]] = true;
+                        neighbours.push_back(adj[j]);
+                    }
+                }
+                std::stable_sort(neighbours.begin(), neighbours.end(), [&](const size_t &a, const size_t &b)
+                                 { return degree(a) < degree(b); });
+                order.insert(order.end(), neighbours.begin(), neighbours.end());
+            }
+        }
+
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
     template <typename T, StorageOrder Order>
     class Matrix
     {
     private:
         size_t rows = 0, cols = 0;
-        std::map<std::array<std::size_t, 2>, T> data;
+        // random insertion goes in the map, batch assembly appends triplets which are summed into it only when needed;
+        // both are mutable because the const accessors merge the pending triplets first
+        mutable std::map<std::array<std::size_t, 2>, T> data;
+        mutable std::vector<Triplet<T>> triplets;
 
         bool compressed = false;
 
         CompressedMatrix<T> compressed_data;
+        // reordered compressed matrix: compressed_data holds P A P^T, permutation[i] is the original index of the index i
+        // and inverse the new index of each original one (both empty without reordering)
+        CompressedArray<size_t> permutation, inverse;
+
+        // blocks of rows (CSR) or columns (CSC) with about the same number of non-zeros, computed when the matrix is compressed
+        std::vector<size_t> partition;
 
         bool check_indexes(const size_t &index1, const size_t &index2) const
         {
@@ -69,60 +644,506 @@ namespace algebra
                 return index1 < cols && index2 < rows;
         }
 
-        void read_matrix_MM(const std::string &filename)
+        size_t position(const size_t &index1, const size_t &index2) const noexcept
+        {
+            /**
+             * @brief Find a non-zero in the compressed matrix
+             * @note Binary search over the sorted minor indexes of the major one, O(log(non-zeros of the row))
+             * @param index1 The row index
+             * @param index2 The column index
+             * @return The position in the compressed arrays, the number of non-zeros if the element is not stored
+             */
+
+            // position in the reordered matrix
+            const size_t major = is_reordered() ? inverse[index1] : index1;
+            const size_t minor = is_reordered() ? inverse[index2] : index2;
+            const size_t *outer = compressed_data.outer_idx.data();
+            const size_t *first = outer + compressed_data.inner_idx[major], *last = outer + compressed_data.inner_idx[major + 1];
+            const size_t *it = std::lower_bound(first, last, minor);
+            return it != last && *it == minor ? it - outer : compressed_data.outer_idx.size();
+        }
+
+        void sort_triplets() const
+        {
+            /**
+             * @brief Sort the pending triplets and sum the duplicates
+             * @note The sort is parallel and stable, so duplicates are summed in the order they were inserted
+             */
+
+            std::stable_sort(std::execution::par, triplets.begin(), triplets.end(), [](const Triplet<T> &a, const Triplet<T> &b)
+                             { return a.idx < b.idx; });
+
+            // sum the duplicates into the first element of each run
+            size_t last = 0;
+            for (size_t i = 1; i < triplets.size(); ++i)
+            {
+                if (triplets[i].idx == triplets[last].idx)
+                    triplets[last].value += triplets[i].value;
+                else
+                    triplets[++last] = triplets[i];
+            }
+
+            if (!triplets.empty())
+                triplets.resize(last + 1);
+        }
+
+        void merge_triplets() const
+        {
+            /**
+             * @brief Move the pending triplets inside the map
+             * @note Used by the operations on the uncompressed matrix, the values of the triplets are added to the ones of the map
+             */
+
+            if (triplets.empty())
+                return;
+
+            sort_triplets();
+
+            // the triplets are sorted, so each one is inserted right after the previous one
+            auto hint = data.begin();
+            for (const auto &t : triplets)
+            {
+                hint = data.try_emplace(hint, t.idx, 0);
+                hint->second += t.value;
+            }
+
+            triplets.clear();
+            triplets.shrink_to_fit();
+        }
+
+        void compress_map()
+        {
+            /**
+             * @brief Compress the matrix from the map
+             */
+
+            // allocate the memory for the compressed matrix
+            if constexpr (Order == StorageOrder::RowMajor)
+                compressed_data.inner_idx.resize(rows + 1, 0);
+            else
+                compressed_data.inner_idx.resize(cols + 1, 0);
+
+            compressed_data.outer_idx.reserve(data.size());
+            compressed_data.data.reserve(data.size());
+
+            // temporary object to store the number of elements in each row
+            auto temp(compressed_data.inner_idx);
+
+            // fill the compressed matrix struct
+            for (auto it = data.begin(); it != data.end(); it++)
+            {
+                ++temp[it->first[0] + 1]; // add 1 to the inner index for each element in that row
+                compressed_data.outer_idx.emplace_back(it->first[1]);
+                compressed_data.data.emplace_back(it->second);
+            }
+
+            // Calculate the cumulative sum so if some line is empty, the inner_idx will be correct
+            std::partial_sum(temp.begin(), temp.end(), compressed_data.inner_idx.begin());
+
+            // Set internal state
+            compressed = true;
+
+            // map can be cleared
+            data.clear();
+        }
+
+        void compress_triplets()
+        {
+            /**
+             * @brief Compress the matrix from the triplets
+             * @note The values of the map are appended to the triplets, then a single sort sums the duplicates and
+             * gives the order of the compressed arrays, without building the map
+             */
+
+            triplets.reserve(triplets.size() + data.size());
+            for (const auto &pair : data)
+                triplets.push_back({pair.first, pair.second});
+            data.clear();
+
+            sort_triplets();
+
+            // allocate the memory for the compressed matrix
+            if constexpr (Order == StorageOrder::RowMajor)
+                compressed_data.inner_idx.assign(rows + 1, 0);
+            else
+                compressed_data.inner_idx.assign(cols + 1, 0);
+
+            compressed_data.outer_idx.resize(triplets.size());
+            compressed_data.data.resize(triplets.size());
+
+            // the triplets are sorted, so the compressed arrays are filled in the same order
+            std::transform(std::execution::par_unseq, triplets.begin(), triplets.end(), compressed_data.outer_idx.begin(), [](const Triplet<T> &t)
+                           { return t.idx[1]; });
+            std::transform(std::execution::par_unseq, triplets.begin(), triplets.end(), compressed_data.data.begin(), [](const Triplet<T> &t)
+                           { return t.value; });
+
+            // count the elements of each row and calculate the cumulative sum, so if some line is empty, the inner_idx will be correct
+            for (const auto &t : triplets)
+                ++compressed_data.inner_idx[t.idx[0] + 1];
+            std::partial_sum(compressed_data.inner_idx.begin(), compressed_data.inner_idx.end(), compressed_data.inner_idx.begin());
+
+            // Set internal state
+            compressed = true;
+
+            // triplets can be released
+            triplets.clear();
+            triplets.shrink_to_fit();
+        }
+
+        void reorder()
+        {
+            /**
+             * @brief Store the compressed matrix reordered by Reverse Cuthill-McKee, P A P^T
+             * @note The same permutation renumbers rows and columns, so it is the same for CSR and CSC
+             */
+
+            if (rows != cols)
+                throw std::invalid_argument("[compress] Only square matrices can be reordered");
+
+            std::vector<size_t> order = reverse_cuthill_mckee(compressed_data);
+            inverse.resize(order.size());
+            for (size_t i = 0; i < order.size(); ++i)
+                inverse[order[i]] = i;
+            permutation.assign(order.size(), 0);
+            std::copy(order.begin(), order.end(), permutation.begin());
+
+            compressed_data = permute(compressed_data, std::span<const size_t>(permutation.begin(), permutation.end()),
+                                      std::span<const size_t>(inverse.begin(), inverse.end()));
+        }
+
+        CompressedMatrix<T> natural_compressed() const
+        {
+            /**
+             * @brief Get the compressed matrix of a reordered one in the original order, O(nnz)
+             * @return The compressed matrix in the storage order of the matrix
+             */
+
+            return permute(compressed_data, std::span<const size_t>(inverse.begin(), inverse.end()),
+                           std::span<const size_t>(permutation.begin(), permutation.end()));
+        }
+
+        static bool parse_entries_MM(const char *begin, const char *end, const std::array<size_t, 2> &size, const bool pattern,
+                                     const bool mirror, const T sign, std::vector<Triplet<T>> &entries)
+        {
+            /**
+             * @brief Parse the entries of a Matrix Market file between two line boundaries
+             * @note The indexes are 1-based in the file and 0-based in the triplets, which are in (row, column) order;
+             * with mirror the element over the diagonal is added too, multiplied by sign
+             * @param begin The first character of the chunk
+             * @param end The character after the last one of the chunk
+             * @param size The number of rows and columns of the matrix
+             * @param pattern True if the entries have no value (it is 1)
+             * @param mirror True if the matrix is symmetric or skew-symmetric
+             * @param sign 1 for symmetric, -1 for skew-symmetric matrices
+             * @param entries The vector where the triplets are appended
+             * @return False if an entry is not valid (it runs inside parallel algorithms, so it does not throw)
+             */
+
+            auto is_space = [](const char c)
+            { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+
+            const char *ptr = begin;
+            while (true)
+            {
+                while (ptr < end && is_space(*ptr))
+                    ++ptr;
+                if (ptr == end)
+                    return true;
+
+                // comment lines can appear among the entries too
+                if (*ptr == '%')
+                {
+                    while (ptr < end && *ptr != '\n')
+                        ++ptr;
+                    continue;
+                }
+
+                size_t row = 0, col = 0;
+                double value = 1;
+
+                auto result = std::from_chars(ptr, end, row);
+                ptr = result.ptr;
+                while (ptr < end && is_space(*ptr))
+                    ++ptr;
+                if (result.ec == std::errc())
+                {
+                    result = std::from_chars(ptr, end, col);
+                    ptr = result.ptr;
+                }
+                if (result.ec == std::errc() && !pattern)
+                {
+                    while (ptr < end && is_space(*ptr))
+                        ++ptr;
+                    // from_chars does not accept the sign +
+                    if (ptr < end && *ptr == '+')
+                        ++ptr;
+                    result = std::from_chars(ptr, end, value);
+                    ptr = result.ptr;
+                }
+
+                if (result.ec != std::errc() || row == 0 || col == 0 || row > size[0] || col > size[1])
+                    return false;
+
+                entries.push_back({{row - 1, col - 1}, static_cast<T>(value)});
+                if (mirror && row != col)
+                    entries.push_back({{col - 1, row - 1}, static_cast<T>(sign * value)});
+            }
+        }
+
+        void load_snapshot(const std::shared_ptr<MappedFile> &file)
+        {
+            /**
+             * @brief Load a binary snapshot written by save
+             * @note The compressed arrays are views inside the mapping, so nothing is read before it is used; the matrix is
+             * compressed and the changes of its values do not reach the file
+             * @param file The mapped snapshot
+             */
+
+            SnapshotHeader header;
+            if (file->size() < sizeof(header))
+                throw std::runtime_error("[load_snapshot] Truncated snapshot");
+            std::memcpy(&header, file->data(), sizeof(header));
+
+            if (header.version != SnapshotHeader::current_version)
+                throw std::runtime_error("[load_snapshot] Unsupported version " + std::to_string(header.version));
+            if (header.endian != SnapshotHeader::endian_value)
+                throw std::runtime_error("[load_snapshot] Snapshot written with a different byte order");
+            if (header.order != static_cast<std::uint32_t>(Order))
+                throw std::runtime_error("[load_snapshot] Snapshot written with a different storage order");
+            if (header.index_size != sizeof(size_t) || header.value_size != sizeof(T) ||
+                header.value_floating != std::is_floating_point_v<T>)
+                throw std::runtime_error("[load_snapshot] Snapshot written with different types");
+
+            const size_t major = Order == StorageOrder::RowMajor ? header.rows : header.cols;
+            auto inside = [&](const std::uint64_t &offset, const std::uint64_t &n, const size_t &element)
+            { return offset % alignof(std::max_align_t) == 0 && offset <= file->size() && n <= (file->size() - offset) / element; };
+            if (header.n_inner != major + 1 || !inside(header.inner_offset, header.n_inner, sizeof(size_t)) ||
+                !inside(header.outer_offset, header.n_outer, sizeof(size_t)) || !inside(header.data_offset, header.n_outer, sizeof(T)))
+                throw std::runtime_error("[load_snapshot] Corrupted snapshot");
+            if (header.n_perm != 0 && (header.n_perm != major || header.rows != header.cols || !inside(header.perm_offset, header.n_perm, sizeof(size_t)) ||
+                                       !inside(header.inverse_offset, header.n_perm, sizeof(size_t))))
+                throw std::runtime_error("[load_snapshot] Corrupted snapshot");
+
+            char *base = file->data();
+            compressed_data.inner_idx.view(file, reinterpret_cast<size_t *>(base + header.inner_offset), header.n_inner);
+            compressed_data.outer_idx.view(file, reinterpret_cast<size_t *>(base + header.outer_offset), header.n_outer);
+            compressed_data.data.view(file, reinterpret_cast<T *>(base + header.data_offset), header.n_outer);
+            if (header.n_perm != 0)
+            {
+                permutation.view(file, reinterpret_cast<size_t *>(base + header.perm_offset), header.n_perm);
+                inverse.view(file, reinterpret_cast<size_t *>(base + header.inverse_offset), header.n_perm);
+            }
+
+            if (compressed_data.inner_idx[0] != 0 || compressed_data.inner_idx.back() != header.n_outer)
+                throw std::runtime_error("[load_snapshot] Corrupted snapshot");
+
+            rows = header.rows;
+            cols = header.cols;
+            compressed = true;
+            partition_nonzeros();
+        }
+
+        void read_matrix_MM(const MappedFile &file)
+        {
+            /**
+             * @brief Read a matrix in Matrix Market format
+             * @note The file is memory mapped and split in chunks of whole lines parsed in parallel with from_chars into triplets,
+             * so compress builds the compressed matrix from them without the map. Real, integer and pattern coordinate matrices
+             * are supported, symmetric and skew-symmetric ones are expanded (hermitian is symmetric for real values)
+             * @param file The mapped file
+             */
+
+            // the file is read once from the beginning to the end
+            file.advise(MADV_SEQUENTIAL);
+            const char *ptr = file.data();
+            const char *const end = ptr + file.size();
+
+            auto next_line = [&]()
+            {
+                const char *line_end = std::find(ptr, end, '\n');
+                std::string line(ptr, line_end);
+                ptr = line_end == end ? end : line_end + 1;
+                return line;
+            };
+
+            // header: %%MatrixMarket matrix coordinate <field> <symmetry>
+            std::string banner, object, format, field, symmetry;
+            std::istringstream header(next_line());
+            header >> banner >> object >> format >> field >> symmetry;
+            auto lower = [](std::string &str)
+            { std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c)
+                             { return std::tolower(c); }); };
+            lower(object);
+            lower(format);
+            lower(field);
+            lower(symmetry);
+
+            if (banner != "%%MatrixMarket" || object != "matrix")
+                throw std::runtime_error("[read_matrix_MM] Not a Matrix Market matrix");
+            if (format != "coordinate")
+                throw std::runtime_error("[read_matrix_MM] Only coordinate matrices are supported");
+            if (field != "real" && field != "double" && field != "integer" && field != "pattern")
+                throw std::runtime_error("[read_matrix_MM] Unsupported field " + field);
+            if (symmetry != "general" && symmetry != "symmetric" && symmetry != "skew-symmetric" && symmetry != "hermitian")
+                throw std::runtime_error("[read_matrix_MM] Unsupported symmetry " + symmetry);
+
+            const bool pattern = field == "pattern";
+            const bool mirror = symmetry != "general";
+            const T sign = symmetry == "skew-symmetric" ? -1 : 1;
+
+            // skip comments + read the number of rows, columns and nonzeros
+            std::string line;
+            do
+            {
+                if (ptr == end)
+                    throw std::runtime_error("[read_matrix_MM] Missing size line");
+                line = next_line();
+            } while (line.empty() || line[0] == '%' || line.find_first_not_of(" \t\r") == std::string::npos);
+
+            size_t n_rows = 0, n_cols = 0, nonzeros = 0;
+            std::istringstream useful_data(line);
+            if (!(useful_data >> n_rows >> n_cols >> nonzeros))
+                throw std::runtime_error("[read_matrix_MM] Invalid size line");
+
+            // chunks of about 1 MB, which end at the end of a line
+            const size_t chunk_size = 1 << 20;
+            std::vector<const char *> bounds{ptr};
+            while (bounds.back() != end)
+            {
+                const char *next = end - bounds.back() > static_cast<std::ptrdiff_t>(chunk_size) ? bounds.back() + chunk_size : end;
+                next = std::find(next, end, '\n');
+                bounds.push_back(next == end ? end : next + 1);
+            }
+
+            std::vector<std::vector<Triplet<T>>> chunks(bounds.size() - 1);
+            std::vector<size_t> ids(chunks.size());
+            std::iota(ids.begin(), ids.end(), 0);
+            std::vector<char> valid(chunks.size());
+            std::for_each(std::execution::par, ids.begin(), ids.end(), [&](const size_t &i)
+                          { valid[i] = parse_entries_MM(bounds[i], bounds[i + 1], {n_rows, n_cols}, pattern, mirror, sign, chunks[i]); });
+            if (std::find(valid.begin(), valid.end(), 0) != valid.end())
+                throw std::runtime_error("[read_matrix_MM] Invalid entry");
+
+            // copy the chunks one after the other into the triplets
+            std::vector<size_t> offsets(chunks.size() + 1, 0);
+            std::transform_inclusive_scan(chunks.begin(), chunks.end(), offsets.begin() + 1, std::plus<>(), [](const auto &chunk)
+                                          { return chunk.size(); });
+
+            size_t diagonal = 0;
+            for (const auto &chunk : chunks)
+                diagonal += std::count_if(chunk.begin(), chunk.end(), [](const Triplet<T> &t)
+                                          { return t.idx[0] == t.idx[1]; });
+            const size_t read = mirror ? (offsets.back() + diagonal) / 2 : offsets.back();
+            if (read != nonzeros)
+                throw std::runtime_error("[read_matrix_MM] Expected " + std::to_string(nonzeros) + " entries, read " + std::to_string(read));
+
+            const size_t first = triplets.size();
+            triplets.resize(first + offsets.back());
+            std::for_each(std::execution::par, ids.begin(), ids.end(), [&](const size_t &i)
+                          {
+                              for (size_t k = 0; k < chunks[i].size(); ++k)
+                              {
+                                  auto t = chunks[i][k];
+                                  if constexpr (Order == StorageOrder::ColumnMajor)
+                                      std::swap(t.idx[0], t.idx[1]);
+                                  triplets[first + offsets[i] + k] = t;
+                              }
+                              std::vector<Triplet<T>>().swap(chunks[i]); });
+
+            rows = n_rows;
+            cols = n_cols;
+        }
+
+        void partition_nonzeros()
+        {
+            /**
+             * @brief Split the compressed matrix in blocks with about the same number of non-zeros, once for all the kernels
+             * @note There is one block for each thread, but each one has at least 32768 non-zeros
+             */
+
+            partition = balanced_partition(std::span<const size_t>(compressed_data.inner_idx.begin(), compressed_data.inner_idx.end()), 1 << 15);
+        }
+
+        const std::vector<size_t> &nnz_partition() const noexcept
         {
             /**
-             * @brief Read a matrix in Matrix Market format
-             * @note This function will read a matrix in Matrix Market format
-             * @param filename The name of the file
+             * @brief Get the blocks of the compressed matrix with about the same number of non-zeros
+             * @return The bounds of the blocks of rows (CSR) or columns (CSC), the first is 0 and the last the number of them
              */
 
-            // check if the filename is valid
-            struct stat buffer;
-            if (stat(filename.c_str(), &buffer) == -1)
-            {
-                throw std::runtime_error("file not found");
-            }
-
-            std::ifstream file(filename);
-            int nonzeros = 0;
+            return partition;
+        }
 
-            // skip comments + read the number of rows, columns and nonzeros
-            std::string line;
-            bool exit = false;
+        const CompressedMatrix<T> &row_compressed(CompressedMatrix<T> &storage) const
+        {
+            /**
+             * @brief Get the matrix in Compressed Sparse Row (CSR) format
+             * @note A compressed RowMajor matrix is returned as it is, the others (and the reordered ones, in the original
+             * order) are converted in storage in O(nnz)
+             * @param storage The matrix where the conversion is saved
+             * @return The CSR matrix
+             */
 
-            while (!exit)
+            if (compressed)
             {
-                getline(file, line);
-                if (line[0] != '%')
+                if (is_reordered())
                 {
-                    std::istringstream useful_data(line);
-                    useful_data >> rows >> cols >> nonzeros;
-                    exit = true;
+                    storage = natural_compressed();
+                    if constexpr (Order == StorageOrder::ColumnMajor)
+                        storage = transpose(storage, rows);
+                    return storage;
                 }
-            }
 
-            // read the matrix
-            size_t row, col;
-            T value;
-            for (int i = 0; i < nonzeros; ++i)
-            {
-                file >> row >> col >> value;
                 if constexpr (Order == StorageOrder::RowMajor)
-                    data[{row - 1, col - 1}] = value;
+                    return compressed_data;
                 else
-                    data[{col - 1, row - 1}] = value;
+                    return storage = transpose(compressed_data, rows);
+            }
+
+            merge_triplets();
+
+            // compressed arrays in the order of the map (CSR or CSC)
+            CompressedMatrix<T> native;
+            native.inner_idx.assign((Order == StorageOrder::RowMajor ? rows : cols) + 1, 0);
+            native.outer_idx.reserve(data.size());
+            native.data.reserve(data.size());
+            for (const auto &pair : data)
+            {
+                ++native.inner_idx[pair.first[0] + 1];
+                native.outer_idx.emplace_back(pair.first[1]);
+                native.data.emplace_back(pair.second);
             }
+            std::partial_sum(native.inner_idx.begin(), native.inner_idx.end(), native.inner_idx.begin());
+
+            if constexpr (Order == StorageOrder::RowMajor)
+                storage = std::move(native);
+            else
+                storage = transpose(native, rows);
 
-            file.close();
+            return storage;
         }
 
     public:
+        // the other layouts are built from the CSR format of the matrix
+        template <typename U, size_t C, size_t Sigma, typename Index>
+        friend class SellMatrix;
+        template <typename U, size_t R, size_t B, typename Index>
+        friend class BlockMatrix;
+        // and so are the preconditioners of the iterative solvers
+        template <typename U>
+        friend class JacobiPreconditioner;
+        template <typename U>
+        friend class ILU0Preconditioner;
+
         // Friend function declaration
         template <typename U, StorageOrder Order_op>
+        friend void multiply(const Matrix<U, Order_op> &m, std::span<const U> x, std::span<U> y, ProductWorkspace<U> &workspace);
+        template <typename U, StorageOrder Order_op>
         friend std::vector<U> operator*(Matrix<U, Order_op> &m, const std::vector<U> &v);
+        template <typename U, StorageOrder Order_op>
+        friend void multiply(const Matrix<U, Order_op> &m, std::span<const U> x, std::span<U> y, const size_t &k, ProductWorkspace<U> &workspace);
         template <typename U, StorageOrder OrderM1, StorageOrder OrderM2>
-        friend Matrix<U, StorageOrder::RowMajor> operator*(const Matrix<T, OrderM1> &m1, const Matrix<T, OrderM2> &m2);
+        friend Matrix<U, StorageOrder::RowMajor> operator*(Matrix<U, OrderM1> &m1, Matrix<U, OrderM2> &m2);
 
         Matrix(const size_t &idx1, const size_t &idx2) noexcept
         {
@@ -150,11 +1171,75 @@ namespace algebra
         {
             /**
              * @brief Constructor for the Matrix class
-             * @note This constructor will read a matrix in Matrix Market format
+             * @note This constructor will read a matrix in Matrix Market format, or map a binary snapshot written by save
+             * @param filename The name of the file
+             */
+
+            auto file = std::make_shared<MappedFile>(filename);
+            if (file->size() >= sizeof(SnapshotHeader) && std::memcmp(file->data(), SnapshotHeader::magic_value, sizeof(SnapshotHeader::magic_value)) == 0)
+                load_snapshot(file);
+            else
+                read_matrix_MM(*file);
+        }
+
+        void save(const std::string &filename) const
+        {
+            /**
+             * @brief Save the compressed matrix in a binary snapshot
+             * @note The constructor taking the filename maps it back without parsing or copying the arrays
              * @param filename The name of the file
              */
 
-            read_matrix_MM(filename);
+            if (!is_compressed())
+                throw std::runtime_error("[save] The matrix must be compressed");
+
+            auto aligned = [](const std::uint64_t &offset)
+            { return (offset + 63) / 64 * 64; };
+
+            SnapshotHeader header{};
+            std::memcpy(header.magic, SnapshotHeader::magic_value, sizeof(header.magic));
+            header.version = SnapshotHeader::current_version;
+            header.endian = SnapshotHeader::endian_value;
+            header.order = static_cast<std::uint32_t>(Order);
+            header.index_size = sizeof(size_t);
+            header.value_size = sizeof(T);
+            header.value_floating = std::is_floating_point_v<T>;
+            header.rows = rows;
+            header.cols = cols;
+            header.n_inner = compressed_data.inner_idx.size();
+            header.n_outer = compressed_data.outer_idx.size();
+            header.inner_offset = aligned(sizeof(header));
+            header.outer_offset = aligned(header.inner_offset + header.n_inner * sizeof(size_t));
+            header.data_offset = aligned(header.outer_offset + header.n_outer * sizeof(size_t));
+            header.n_perm = permutation.size();
+            header.perm_offset = aligned(header.data_offset + header.n_outer * sizeof(T));
+            header.inverse_offset = aligned(header.perm_offset + header.n_perm * sizeof(size_t));
+
+            std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+            if (!file)
+                throw std::runtime_error("[save] Cannot open " + filename);
+
+            std::uint64_t position = 0;
+            auto write = [&](const void *values, const std::uint64_t &offset, const std::uint64_t &bytes)
+            {
+                static const char zeros[64] = {};
+                file.write(zeros, offset - position);
+                file.write(static_cast<const char *>(values), bytes);
+                position = offset + bytes;
+            };
+
+            write(&header, 0, sizeof(header));
+            write(compressed_data.inner_idx.data(), header.inner_offset, header.n_inner * sizeof(size_t));
+            write(compressed_data.outer_idx.data(), header.outer_offset, header.n_outer * sizeof(size_t));
+            write(compressed_data.data.data(), header.data_offset, header.n_outer * sizeof(T));
+            if (is_reordered())
+            {
+                write(permutation.data(), header.perm_offset, header.n_perm * sizeof(size_t));
+                write(inverse.data(), header.inverse_offset, header.n_perm * sizeof(size_t));
+            }
+
+            if (!file)
+                throw std::runtime_error("[save] Cannot write " + filename);
         }
 
         void print() const noexcept
@@ -183,6 +1268,14 @@ namespace algebra
                 for (const auto &idx : compressed_data.data)
                     std::cout << idx << " " << std::endl;
                 std::cout << std::endl;
+
+                if (is_reordered())
+                {
+                    std::cout << "Permutation: " << std::endl;
+                    for (const auto &idx : permutation)
+                        std::cout << idx << " ";
+                    std::cout << std::endl;
+                }
             }
             else
             {
@@ -192,6 +1285,7 @@ namespace algebra
                 std::string placeholder2 = Order == StorageOrder::RowMajor ? "Column" : "Row";
                 std::cout << placeholder1 << " " << placeholder2 << " " << " Data " << std::endl;
                 std::cout << "----------------------" << std::endl;
+                merge_triplets();
                 for(auto && pair: data){
                     std::cout << pair.first[0] << '\t' << pair.first[1] << '\t' << pair.second << std::endl;
                 }
@@ -227,6 +1321,8 @@ namespace algebra
             {
                 if (!is_compressed())
                 {
+                    merge_triplets();
+
                     // if the element is not in the map, add it
                     if (data.find({index1, index2}) == data.end())
                         data[{index1, index2}] = 0;
@@ -235,17 +1331,9 @@ namespace algebra
                 }
                 else
                 {
-                    size_t idx = compressed_data.inner_idx[index1];
-
-                    while (idx < compressed_data.inner_idx[index1 + 1])
-                    {
-                        if (compressed_data.outer_idx[idx] == index2)
-                        {
-                            return compressed_data.data[idx];
-                        }
-
-                        ++idx;
-                    }
+                    const size_t idx = position(index1, index2);
+                    if (idx < compressed_data.outer_idx.size())
+                        return compressed_data.data[idx];
 
                     throw std::out_of_range("[operator()] Attempt to add value while the matrix is compressed");
                 }
@@ -267,21 +1355,19 @@ namespace algebra
             if (check_indexes(index1, index2))
             {
                 if (!is_compressed())
+                {
+                    merge_triplets();
+
                     // if the element is not in the map, return 0
                     if (data.find({index1, index2}) == data.cend())
                         return 0;
                     else
                         return data.at({index1, index2});
+                }
                 else
                 {
-                    size_t idx = compressed_data.inner_idx[index1];
-                    while (idx < compressed_data.inner_idx[index1 + 1])
-                    {
-                        if (compressed_data.outer_idx[idx] == index2)
-                            return compressed_data.data[idx];
-                        ++idx;
-                    }
-                    return 0;
+                    const size_t idx = position(index1, index2);
+                    return idx < compressed_data.outer_idx.size() ? compressed_data.data[idx] : 0;
                 }
             }
             else
@@ -290,45 +1376,115 @@ namespace algebra
             }
         }
 
-        void compress() noexcept
+        void insert(const size_t &index1, const size_t &index2, const T &value)
         {
             /**
-             * @brief Compress the matrix
-             * @note This function will compress the matrix in a CompressedMatrix struct using Compressed Sparse Row (CSR) format
-             * or Compressed Sparse Column (CSC) format
+             * @brief Add a value to the matrix without a lookup
+             * @note The value is appended as a triplet and summed with the others of the same position (and the one already
+             * in the matrix) by compress, so the assembly in any order costs one sort instead of a node of the map for each value
+             * @param index1 The row index
+             * @param index2 The column index
+             * @param value The value to add
              */
 
-            if (compressed)
-                return;
+            if (is_compressed())
+                throw std::out_of_range("[insert] Attempt to add value while the matrix is compressed");
 
-            // allocate the memory for the compressed matrix
-            if constexpr (Order == StorageOrder::RowMajor)
-                compressed_data.inner_idx.resize(rows + 1, 0);
-            else
-                compressed_data.inner_idx.resize(cols + 1, 0);
+            if (!check_indexes(index1, index2))
+                throw std::out_of_range("[insert] Invalid indexes");
 
-            compressed_data.outer_idx.reserve(data.size());
-            compressed_data.data.reserve(data.size());
+            triplets.push_back({{index1, index2}, value});
+        }
 
-            // temporary object to store the number of elements in each row
-            auto temp(compressed_data.inner_idx);
+        void set_values(std::span<const Triplet<T>> entries)
+        {
+            /**
+             * @brief Replace the values of the compressed matrix, keeping its pattern
+             * @note Each value becomes the sum of the entries in its position (0 without entries), like the assembly with
+             * insert: the entries are found by binary search and added in parallel with atomic updates, so the arrays of
+             * indexes do not change and nothing is allocated, O(nnz + entries * log(non-zeros of a row)). The sums of
+             * repeated positions are in any order
+             * @param entries The entries ({index1, index2}, value), each one in the pattern of the matrix
+             */
 
-            // fill the compressed matrix struct
-            for (auto it = data.begin(); it != data.end(); it++)
+            if (!is_compressed())
+                throw std::runtime_error("[set_values] The matrix must be compressed");
+
+            // checked before any change, the parallel algorithms cannot throw
+            const size_t nonzeros = compressed_data.outer_idx.size();
+            const bool valid = std::all_of(std::execution::par_unseq, entries.begin(), entries.end(), [&](const Triplet<T> &t)
+                                           { return check_indexes(t.idx[0], t.idx[1]) && position(t.idx[0], t.idx[1]) < nonzeros; });
+            if (!valid)
+                throw std::out_of_range("[set_values] Entry outside the pattern of the matrix");
+
+            std::fill(std::execution::par_unseq, compressed_data.data.begin(), compressed_data.data.end(), T(0));
+            T *values = compressed_data.data.begin();
+            std::for_each(std::execution::par, entries.begin(), entries.end(), [&](const Triplet<T> &t)
+                          { std::atomic_ref<T>(values[position(t.idx[0], t.idx[1])]).fetch_add(t.value, std::memory_order_relaxed); });
+        }
+
+        template <typename Function>
+        void update_values(Function &&f)
+        {
+            /**
+             * @brief Update the values of the compressed matrix in place, keeping its pattern
+             * @note The non-zeros are split in blocks of rows (CSR) or columns (CSC) with the same number of non-zeros which
+             * run in parallel, so f is called concurrently and must not throw; O(nnz), the arrays of indexes do not change
+             * @param f The function called as f(index1, index2, value) for each non-zero, which returns its new value
+             */
+
+            if (!is_compressed())
+                throw std::runtime_error("[update_values] The matrix must be compressed");
+
+            auto original = [this](const size_t &i)
+            { return is_reordered() ? permutation[i] : i; };
+
+            const size_t *inner = compressed_data.inner_idx.data();
+            const size_t *outer = compressed_data.outer_idx.data();
+            T *values = compressed_data.data.begin();
+            const std::vector<size_t> &bounds = nnz_partition();
+            for_each_block(bounds.size() - 1, [&](const size_t &b)
+                           {
+                               for (size_t i = bounds[b]; i < bounds[b + 1]; ++i)
+                               {
+                                   const size_t index1 = original(i);
+                                   for (size_t j = inner[i]; j < inner[i + 1]; ++j)
+                                       values[j] = f(index1, original(outer[j]), values[j]);
+                               } });
+        }
+
+        void reserve(const size_t &nonzeros)
+        {
+            /**
+             * @brief Reserve the memory for the triplets added by insert
+             * @param nonzeros The number of values which will be inserted
+             */
+
+            triplets.reserve(nonzeros);
+        }
+
+        void compress(const reordering_type &reordering = Natural)
+        {
+            /**
+             * @brief Compress the matrix
+             * @note This function will compress the matrix in a CompressedMatrix struct using Compressed Sparse Row (CSR) format
+             * or Compressed Sparse Column (CSC) format; with RCM a square matrix is stored reordered by Reverse Cuthill-McKee,
+             * which reduces its bandwidth, also when it is already compressed
+             * @param reordering The ordering of the compressed matrix
+             */
+
+            if (!compressed)
             {
-                ++temp[it->first[0] + 1]; // add 1 to the inner index for each element in that row
-                compressed_data.outer_idx.emplace_back(it->first[1]);
-                compressed_data.data.emplace_back(it->second);
+                if (!triplets.empty())
+                    compress_triplets();
+                else
+                    compress_map();
             }
 
-            // Calculate the cumulative sum so if some line is empty, the inner_idx will be correct
-            std::partial_sum(temp.begin(), temp.end(), compressed_data.inner_idx.begin());
-
-            // Set internal state
-            compressed = true;
+            if (reordering == RCM && !is_reordered())
+                reorder();
 
-            // map can be cleared
-            data.clear();
+            partition_nonzeros();
         }
 
         void uncompress() noexcept
@@ -342,12 +1498,16 @@ namespace algebra
             if (!compressed)
                 return;
 
+            // the map is in the original order
+            auto original = [this](const size_t &i)
+            { return is_reordered() ? permutation[i] : i; };
+
             size_t idx = 0;
             for (size_t i = 0; i < compressed_data.inner_idx.size() - 1; i++)
             {
                 for (size_t j = compressed_data.inner_idx[i]; j < compressed_data.inner_idx[i + 1]; j++)
                 {
-                    data[{i, compressed_data.outer_idx[j]}] = compressed_data.data[idx];
+                    data[{original(i), original(compressed_data.outer_idx[j])}] = compressed_data.data[idx];
                     ++idx;
                 }
             }
@@ -359,6 +1519,9 @@ namespace algebra
             compressed_data.inner_idx.clear();
             compressed_data.outer_idx.clear();
             compressed_data.data.clear();
+            permutation.clear();
+            inverse.clear();
+            partition.clear();
         }
 
         void resize(const size_t &idx1, const size_t &idx2) noexcept
@@ -384,6 +1547,8 @@ namespace algebra
             if (is_compressed())
                 uncompress();
 
+            merge_triplets();
+
             for (auto temp = data.begin(); temp != data.end();)
             {
                 // check if the indexes are valid with new dimensions
@@ -398,215 +1563,418 @@ namespace algebra
             }
         }
 
+        size_t bandwidth() const
+        {
+            /**
+             * @brief Calculate the bandwidth of the matrix, the maximum distance of a non-zero from the diagonal
+             * @note A reordered matrix has the bandwidth of its stored order, which is the one of the products
+             * @return The bandwidth of the matrix
+             */
+
+            size_t result = 0;
+            auto update = [&result](const size_t &i, const size_t &j)
+            { result = std::max(result, i > j ? i - j : j - i); };
+
+            if (!is_compressed())
+            {
+                merge_triplets();
+                for (const auto &pair : data)
+                    update(pair.first[0], pair.first[1]);
+                return result;
+            }
+
+            for (size_t i = 0; i + 1 < compressed_data.inner_idx.size(); ++i)
+                for (size_t j = compressed_data.inner_idx[i]; j < compressed_data.inner_idx[i + 1]; ++j)
+                    update(i, compressed_data.outer_idx[j]);
+            return result;
+        }
+
         template <norm_type Norm>
         double norm() const
         {
             /**
              * @brief Calculate the norm of the matrix
-             * @note This function will calculate the norm of the matrix
+             * @note This function will calculate the norm of the matrix in a single pass over the non-zeros, O(nnz):
+             * One and Infinity accumulate the absolute values of each column or row in a vector, then take the maximum.
+             * The compressed matrix is split in blocks with the same number of non-zeros which run in parallel
              * @return The norm of the matrix
              */
-            if constexpr (Norm == norm_type::One)
+
+            static_assert(Norm == norm_type::One || Norm == norm_type::Infinity || Norm == norm_type::Frobenius, "[norm] Invalid norm type");
+
+            if constexpr (Norm == norm_type::Frobenius)
             {
-                double max = 0;
                 if (!is_compressed())
                 {
-                    for (size_t c = 0; c < cols; c++)
-                    {
-                        T sum = 0; // temporary variable to store the sum of the elements of each row
-                        for (size_t r = 0; r < rows; r++)
-                        {
-                            if constexpr (Order == StorageOrder::RowMajor)
-                                sum += std::abs((*this)(r, c));
-                            else
-                                sum += std::abs((*this)(c, r));
-                        }
-
-                        if (sum > max)
-                            max = sum;
-                    }
-                }
-                else{
-                    // TODO: improve version for RowMajor
-                    if constexpr (Order == StorageOrder::RowMajor){
-                        for (size_t i = 0; i < cols; i++){
-                            T sum = 0;
-                            // search inside the outer index array if we reach the correct column
-                            for (size_t j = 0; j < compressed_data.outer_idx.size(); j++){
-                                if (compressed_data.outer_idx[j] == i)
-                                    sum += std::abs(compressed_data.data[j]);
-                            }
-                            if (sum > max)
-                                max = sum;
-                        }
-                    }
-                    else{
-                        for (size_t i = 0; i < cols; i++)
-                        {
-                            T sum = 0;
-                            for (size_t j = compressed_data.inner_idx[i]; j < compressed_data.inner_idx[i + 1]; j++)
-                            {
-                                sum += std::abs(compressed_data.data[j]);
-                            }
-
-                            if (sum > max)
-                                max = sum;
-                        }
-                    }
+                    merge_triplets();
+                    double sum = 0;
+                    for (const auto &pair : data)
+                        sum += std::abs(pair.second) * std::abs(pair.second);
+                    return std::sqrt(sum);
                 }
 
-                return max;
+                return std::sqrt(std::transform_reduce(std::execution::par_unseq, compressed_data.data.begin(), compressed_data.data.end(), 0.0,
+                                                       std::plus<>(), [](const T &val)
+                                                       { return static_cast<double>(std::abs(val)) * std::abs(val); }));
             }
-            else if constexpr (Norm == norm_type::Infinity)
+            else
             {
-                T max = 0;
+                // One sums along the columns and Infinity along the rows: this is the major index of the storage when
+                // the two match (rows of RowMajor for Infinity, columns of ColumnMajor for One)
+                constexpr bool along_major = (Norm == norm_type::Infinity) == (Order == StorageOrder::RowMajor);
+                const size_t n_major = Order == StorageOrder::RowMajor ? rows : cols;
+                const size_t n_minor = Order == StorageOrder::RowMajor ? cols : rows;
+
                 if (!is_compressed())
                 {
-                    for (size_t r = 0; r < rows; r++)
-                    {
-                        T sum = 0; // temporary variable to store the sum of the elements of each row
-                        for (size_t c = 0; c < cols; c++)
-                        {
-                            if constexpr (Order == StorageOrder::RowMajor)
-                                sum += std::abs((*this)(r, c));
-                            else
-                                sum += std::abs((*this)(c, r));
-                        }
-
-                        if (sum > max)
-                            max = sum;
-                    }
-                }
-                else
-                {
-                    if constexpr (Order == StorageOrder::RowMajor)
-                    {
-                        for (size_t i = 0; i < rows; i++)
-                        {
-                            T sum = 0;
-                            for (size_t j = compressed_data.inner_idx[i]; j < compressed_data.inner_idx[i + 1]; j++)
-                            {
-                                sum += std::abs(compressed_data.data[j]);
-                            }
-                            if (sum > max)
-                                max = sum;
-                        }
-                    }
-                    // TODO: improve version for ColumnMajor
-                    else
-                    {
-                        for (size_t i = 0; i < rows; i++)
-                        {
-                            T sum = 0;
-                            // search inside the outer index array if we reach the correct row
-                            for (size_t j = 0; j < compressed_data.outer_idx.size(); j++)
-                            {
-                                if (compressed_data.outer_idx[j] == i)
-                                    sum += std::abs(compressed_data.data[j]);
-                            }
-                            if (sum > max)
-                                max = sum;
-                        }
-                    }
+                    merge_triplets();
+                    std::vector<double> sums(along_major ? n_major : n_minor, 0);
+                    for (const auto &pair : data)
+                        sums[pair.first[along_major ? 0 : 1]] += std::abs(pair.second);
+                    return sums.empty() ? 0 : *std::max_element(sums.begin(), sums.end());
                 }
 
-                return max;
-            }
-            else if constexpr (Norm == norm_type::Frobenius)
-            {
-                double sum = 0;
-                if (!is_compressed())
+                const size_t *inner = compressed_data.inner_idx.data();
+                const size_t *outer = compressed_data.outer_idx.data();
+                const T *values = compressed_data.data.data();
+                const std::vector<size_t> &bounds = nnz_partition();
+                const size_t n_blocks = bounds.size() - 1;
+
+                if constexpr (along_major)
                 {
-                    for (size_t r = 0; r < rows; r++)
-                    {
-                        for (size_t c = 0; c < cols; c++)
-                        {
-                            if constexpr (Order == StorageOrder::RowMajor)
-                                sum += (*this)(r, c) * (*this)(r, c);
-                            else
-                                sum += (*this)(c, r) * (*this)(c, r);
-                        }
-                    }
+                    // each row (or column) is summed by one block, which keeps its maximum
+                    std::vector<double> max(n_blocks, 0);
+                    for_each_block(n_blocks, [&](const size_t &b)
+                                   {
+                                       for (size_t i = bounds[b]; i < bounds[b + 1]; ++i)
+                                       {
+                                           double sum = 0;
+                                           #pragma omp simd reduction(+ : sum)
+                                           for (size_t j = inner[i]; j < inner[i + 1]; ++j)
+                                               sum += std::abs(values[j]);
+                                           max[b] = std::max(max[b], sum);
+                                       } });
+                    return *std::max_element(max.begin(), max.end());
                 }
                 else
                 {
-                    // temporary object to store the squared absolute values
-                    auto temp(compressed_data.data);
-
-                    // Transform the vector to hold the squared absolute values
-                    std::transform(temp.begin(), temp.end(), temp.begin(), [](T val)
-                                   { return std::abs(val) * std::abs(val); });
-
-                    // Sum the elements of the vector
-                    sum = std::accumulate(temp.begin(), temp.end(), 0.0);
+                    // each block accumulates the columns (or rows) of its non-zeros in its own vector, summed at the end
+                    std::vector<std::vector<double>> sums(n_blocks);
+                    for_each_block(n_blocks, [&](const size_t &b)
+                                   {
+                                       sums[b].assign(n_minor, 0);
+                                       double *target = sums[b].data();
+                                       for (size_t j = inner[bounds[b]]; j < inner[bounds[b + 1]]; ++j)
+                                           target[outer[j]] += std::abs(values[j]); });
+
+                    std::vector<size_t> idx(n_minor);
+                    std::iota(idx.begin(), idx.end(), 0);
+                    return std::transform_reduce(std::execution::par_unseq, idx.begin(), idx.end(), 0.0, [](const double &x, const double &y)
+                                                 { return std::max(x, y); }, [&](const size_t &i)
+                                                 {
+                                                     double sum = 0;
+                                                     for (const auto &block : sums)
+                                                         sum += block[i];
+                                                     return sum; });
                 }
-                return std::sqrt(sum);
             }
-
-            throw std::invalid_argument("[norm] Invalid norm type");
         }
 
         // Getter
         size_t get_rows() const noexcept { return rows; }
         size_t get_cols() const noexcept { return cols; }
+        size_t get_nonzeros() const { return compressed ? compressed_data.outer_idx.size() : (merge_triplets(), data.size()); }
         StorageOrder get_order() const noexcept { return Order; }
         bool is_compressed() const noexcept { return compressed; }
+        bool is_mapped() const noexcept { return compressed_data.data.is_view(); }
+        bool is_reordered() const noexcept { return !permutation.empty(); }
+        // original index of each index of the reordered matrix, empty without reordering
+        std::span<const size_t> get_permutation() const noexcept { return std::span<const size_t>(permutation.begin(), permutation.end()); }
     };
 
+    template <typename T>
+    void add_partial(const std::vector<std::vector<T>> &partial, const size_t &n_blocks, std::span<T> y)
+    {
+        /**
+         * @brief Sum the accumulators of the blocks after the first one into the result of a CSC product
+         * @note The result is split in one chunk of rows for each block, so the threads of the product sum them
+         * @param partial The accumulators, at least n_blocks - 1, each with at least the size of y
+         * @param n_blocks The number of blocks of the product
+         * @param y The result, holding the accumulator of the first block
+         */
+
+        if (n_blocks < 2)
+            return;
+
+        for_each_block(n_blocks, [&](const size_t &b)
+                       {
+                           for (const size_t r : std::views::iota(b * y.size() / n_blocks, (b + 1) * y.size() / n_blocks))
+                               for (size_t p = 0; p + 1 < n_blocks; ++p)
+                                   y[r] += partial[p][r]; });
+    }
+
+    template <typename T, StorageOrder Order>
+    void multiply(const Matrix<T, Order> &m, std::span<const T> x, std::span<T> y, ProductWorkspace<T> &workspace)
+    {
+        /**
+         * @brief Multiply a matrix by a vector, writing the result in a buffer of the caller
+         * @note The compressed matrix is split in blocks of rows (CSR) or columns (CSC) with the same number of non-zeros,
+         * multiplied in parallel: with CSR each block writes its own rows, with CSC each block accumulates its columns
+         * in a private vector of the workspace and the vectors are summed at the end
+         * @param m The matrix
+         * @param x The vector, of size the number of columns
+         * @param y The result, of size the number of rows
+         * @param workspace The scratch of the product, which must not be used by another product at the same time
+         */
+
+        if (x.size() != m.get_cols() || y.size() != m.get_rows())
+            throw std::invalid_argument("[multiply] The sizes of the vectors must be the number of columns and rows of the matrix");
+
+        if (!m.is_compressed())
+        {
+            m.merge_triplets();
+            std::fill(y.begin(), y.end(), 0);
+
+            size_t temp_rows = m.get_rows(), temp_cols = m.get_cols();
+            for (size_t i = 0; i < temp_rows; i++)
+            {
+                for (size_t j = 0; j < temp_cols; j++)
+                {
+                    // O(log(data non-zeros))
+                    auto it = Order == StorageOrder::RowMajor ? m.data.find({i, j}) : m.data.find({j, i});
+                    if (it != m.data.end())
+                        y[i] += it->second * x[j];
+                }
+            }
+            return;
+        }
+
+        // a reordered matrix is P A P^T, so y = P^T (P A P^T) (P x)
+        std::span<const T> xs = x;
+        std::span<T> ys = y;
+        if (m.is_reordered())
+        {
+            const size_t *perm = m.permutation.data();
+            const std::span<T> x_perm = workspace.get(workspace.x_perm, x.size());
+            std::transform(std::execution::par_unseq, perm, perm + x.size(), x_perm.begin(), [&](const size_t &i)
+                           { return x[i]; });
+            xs = x_perm;
+            ys = workspace.get(workspace.y_perm, y.size());
+        }
+
+        const size_t *inner = m.compressed_data.inner_idx.data();
+        const size_t *outer = m.compressed_data.outer_idx.data();
+        const T *values = m.compressed_data.data.data();
+        const std::vector<size_t> &bounds = m.nnz_partition();
+        const size_t n_blocks = bounds.size() - 1;
+
+        if constexpr (Order == StorageOrder::RowMajor)
+        {
+            for_each_block(n_blocks, [&](const size_t &b)
+                           {
+                               for (size_t i = bounds[b]; i < bounds[b + 1]; ++i)
+                               {
+                                   T sum = 0;
+                                   #pragma omp simd reduction(+ : sum)
+                                   for (size_t j = inner[i]; j < inner[i + 1]; ++j)
+                                       sum += values[j] * xs[outer[j]];
+                                   ys[i] = sum;
+                               } });
+        }
+        else
+        {
+            // the first block accumulates directly in y, the others in their own vector
+            if (workspace.partial.size() < n_blocks - 1)
+                workspace.partial.resize(n_blocks - 1);
+            for_each_block(n_blocks, [&](const size_t &b)
+                           {
+                              const std::span<T> target = b > 0 ? workspace.get(workspace.partial[b - 1], ys.size()) : ys;
+                              std::fill(target.begin(), target.end(), 0);
+
+                              for (size_t i = bounds[b]; i < bounds[b + 1]; ++i)
+                              {
+                                  const T value = xs[i];
+                                  // the rows of a column are different, so the scatter has no conflicts
+                                  #pragma omp simd
+                                  for (size_t j = inner[i]; j < inner[i + 1]; ++j)
+                                      target[outer[j]] += values[j] * value;
+                              } });
+
+            add_partial(workspace.partial, n_blocks, ys);
+        }
+
+        if (m.is_reordered())
+        {
+            const size_t *inv = m.inverse.data();
+            std::transform(std::execution::par_unseq, inv, inv + y.size(), y.begin(), [&](const size_t &i)
+                           { return ys[i]; });
+        }
+    }
+
+    template <typename T, StorageOrder Order>
+    void multiply(const Matrix<T, Order> &m, std::span<const T> x, std::span<T> y)
+    {
+        /**
+         * @brief Multiply a matrix by a vector, writing the result in a buffer of the caller
+         * @note The product has a workspace of its own, so it allocates the scratch of CSC and of a reordered matrix: the
+         * callers which repeat the products pass their ProductWorkspace instead
+         * @param m The matrix
+         * @param x The vector, of size the number of columns
+         * @param y The result, of size the number of rows
+         */
+
+        ProductWorkspace<T> workspace;
+        multiply(m, x, y, workspace);
+    }
+
     template <typename T, StorageOrder Order>
     std::vector<T> operator*(Matrix<T, Order> &m, const std::vector<T> &v)
     {
         /**
          * @brief Multiply a matrix by a vector
-         * @note This function will multiply a matrix by a vector
+         * @note This function will multiply a matrix by a vector, see multiply
          * @param m The matrix
          * @param v The vector
          * @return The result of the multiplication
          */
 
         std::vector<T> result(m.get_rows(), 0);
+        multiply(m, std::span<const T>(v), std::span<T>(result));
+        return result;
+    }
+
+    template <typename T, StorageOrder Order>
+    void multiply(const Matrix<T, Order> &m, std::span<const T> x, std::span<T> y, const size_t &k, ProductWorkspace<T> &workspace)
+    {
+        /**
+         * @brief Multiply a matrix by a dense block of k vectors, writing the result in a buffer of the caller
+         * @note The blocks are stored row by row, so each non-zero of the matrix multiplies a contiguous row of k values of x
+         * (an omp simd loop) and the matrix is read once for all the vectors. The compressed matrix is split in blocks with
+         * the same number of non-zeros like in the product by a vector
+         * @param m The matrix
+         * @param x The block of k vectors, rows x k values with rows the number of columns of the matrix
+         * @param y The result, rows x k values with rows the number of rows of the matrix
+         * @param k The number of vectors
+         * @param workspace The scratch of the product, which must not be used by another product at the same time
+         */
+
+        if (x.size() != m.get_cols() * k || y.size() != m.get_rows() * k)
+            throw std::invalid_argument("[multiply] The sizes of the blocks must be the number of columns and rows of the matrix times k");
 
-        // Error handling of wrong dimensions
-        /*
-        if(m.get_cols() != v.size()){
-            throw std::invalid_argument("[Operator*] The number of columns of the matrix must be equal to the size of the vector");
+        // a single compressed vector uses the kernels of the product by a vector
+        if (k == 1 && m.is_compressed())
+        {
+            multiply(m, x, y, workspace);
+            return;
         }
-        */
+
+        // y(row, :) += value * x(col, :)
+        auto update = [k](T *y_row, const T *x_row, const T value)
+        {
+            #pragma omp simd
+            for (size_t c = 0; c < k; ++c)
+                y_row[c] += value * x_row[c];
+        };
 
         if (!m.is_compressed())
         {
-            size_t temp_rows = m.get_rows(), temp_cols = m.get_cols();
-            for (size_t i = 0; i < temp_rows; i++)
+            m.merge_triplets();
+            std::fill(y.begin(), y.end(), 0);
+            for (const auto &pair : m.data)
             {
-                for (size_t j = 0; j < temp_cols; j++)
-                {
-                    if constexpr (Order == StorageOrder::RowMajor){
-                        if(m.data.find({i, j}) != m.data.end()) // O(log(data non-zeros))
-                            result[i] += m.data[{i, j}] * v[j];
-                    }
-                    else
-                        if(m.data.find({j, i}) != m.data.end())
-                            result[i] += m.data[{j, i}] * v[j];
-                }
+                const size_t row = Order == StorageOrder::RowMajor ? pair.first[0] : pair.first[1];
+                const size_t col = Order == StorageOrder::RowMajor ? pair.first[1] : pair.first[0];
+                update(y.data() + row * k, x.data() + col * k, pair.second);
             }
+            return;
+        }
+
+        // a reordered matrix is P A P^T: the rows of x and y are permuted like the vectors of the product by a vector
+        std::span<const T> xs = x;
+        std::span<T> ys = y;
+        if (m.is_reordered())
+        {
+            const std::span<T> x_perm = workspace.get(workspace.x_perm, x.size());
+            for (size_t i = 0; i < m.permutation.size(); ++i)
+                std::copy_n(x.data() + m.permutation[i] * k, k, x_perm.data() + i * k);
+            xs = x_perm;
+            ys = workspace.get(workspace.y_perm, y.size());
+        }
+
+        const size_t *inner = m.compressed_data.inner_idx.data();
+        const size_t *outer = m.compressed_data.outer_idx.data();
+        const T *values = m.compressed_data.data.data();
+        const std::vector<size_t> &bounds = m.nnz_partition();
+        const size_t n_blocks = bounds.size() - 1;
+
+        if constexpr (Order == StorageOrder::RowMajor)
+        {
+            for_each_block(n_blocks, [&](const size_t &b)
+                           {
+                               for (size_t i = bounds[b]; i < bounds[b + 1]; ++i)
+                               {
+                                   T *y_row = ys.data() + i * k;
+                                   std::fill(y_row, y_row + k, 0);
+                                   for (size_t j = inner[i]; j < inner[i + 1]; ++j)
+                                       update(y_row, xs.data() + outer[j] * k, values[j]);
+                               } });
         }
         else
         {
-           if constexpr(Order == StorageOrder::RowMajor){
-               for(size_t i = 0; i < m.get_rows(); i++){
-                   for(size_t j = m.compressed_data.inner_idx[i]; j < m.compressed_data.inner_idx[i + 1]; j++){
-                       result[i] += m.compressed_data.data[j] * v[m.compressed_data.outer_idx[j]];
-                   }
-               }
-           }
-           else{
-               for(size_t i = 0; i < m.get_cols(); i++){
-                   for(size_t j = m.compressed_data.inner_idx[i]; j < m.compressed_data.inner_idx[i + 1]; j++){
-                       result[m.compressed_data.outer_idx[j]] += m.compressed_data.data[j] * v[i];
-                   }
-               }
-           }
+            // the first block accumulates directly in y, the others in their own block
+            if (workspace.partial.size() < n_blocks - 1)
+                workspace.partial.resize(n_blocks - 1);
+            for_each_block(n_blocks, [&](const size_t &b)
+                           {
+                               const std::span<T> target = b > 0 ? workspace.get(workspace.partial[b - 1], ys.size()) : ys;
+                               std::fill(target.begin(), target.end(), 0);
+
+                               for (size_t i = bounds[b]; i < bounds[b + 1]; ++i)
+                                   for (size_t j = inner[i]; j < inner[i + 1]; ++j)
+                                       update(target.data() + outer[j] * k, xs.data() + i * k, values[j]); });
+
+            add_partial(workspace.partial, n_blocks, ys);
+        }
+
+        if (m.is_reordered())
+        {
+            for (size_t i = 0; i < m.permutation.size(); ++i)
+                std::copy_n(ys.data() + i * k, k, y.data() + m.permutation[i] * k);
         }
+    }
+
+    template <typename T, StorageOrder Order>
+    void multiply(const Matrix<T, Order> &m, std::span<const T> x, std::span<T> y, const size_t &k)
+    {
+        /**
+         * @brief Multiply a matrix by a dense block of k vectors with a workspace of its own, see the product by a vector
+         * @param m The matrix
+         * @param x The block of k vectors, rows x k values with rows the number of columns of the matrix
+         * @param y The result, rows x k values with rows the number of rows of the matrix
+         * @param k The number of vectors
+         */
+
+        ProductWorkspace<T> workspace;
+        multiply(m, x, y, k, workspace);
+    }
+
+    template <typename T, StorageOrder Order>
+    DenseMatrix<T> operator*(Matrix<T, Order> &m, const DenseMatrix<T> &x)
+    {
+        /**
+         * @brief Multiply a matrix by a dense matrix
+         * @note This function will multiply a sparse matrix by a dense block of vectors in a single pass over the sparse
+         * matrix, see multiply
+         * @param m The sparse matrix
+         * @param x The dense matrix
+         * @return The result of the multiplication
+         */
+
+        if (m.get_cols() != x.get_rows())
+            throw std::invalid_argument("[Operator*(Matrix, DenseMatrix)] The number of columns of the first matrix must be equal to the number of rows of the second matrix");
+
+        DenseMatrix<T> result(m.get_rows(), x.get_cols());
+        multiply(m, x.data(), result.data(), x.get_cols());
         return result;
     }
 
@@ -615,7 +1983,9 @@ namespace algebra
     {
         /**
          * @brief Multiply two matrices
-         * @note This function will multiply two matrices
+         * @note Sparse product (SpGEMM) with a symbolic phase, which counts the non-zeros of each row of the result, and a
+         * numeric one, both parallel over blocks of rows; the matrices are used in CSR format (converted when they are
+         * not compressed RowMajor) and the result is compressed
          * @param m1 The first matrix
          * @param m2 The second matrix
          * @return The result of the multiplication
@@ -624,35 +1994,91 @@ namespace algebra
         if (m1.get_cols() != m2.get_rows())
             throw std::invalid_argument("[Operator*(Matrix, Matrix)] The number of columns of the first matrix must be equal to the number of rows of the second matrix");
 
-        Matrix<T, StorageOrder::RowMajor> resultMatrix(1, 1);
-
-        resultMatrix.resize(m1.get_rows(), m2.get_cols());
-
-        // TODO: refactor this code and improve it
-        for (size_t c = 0; c < m2.get_cols(); ++c){
-            std::vector<T> result(m1.get_rows(), 0);
-
-            // temporary vector to store values of the column
-            std::vector<T> temp(m2.get_rows(), 0);
+        // Gustavson: the row i of the result is the sum of the rows k of m2 multiplied by m1(i, k)
+        CompressedMatrix<T> storage1, storage2;
+        const CompressedMatrix<T> &a = m1.row_compressed(storage1);
+        const CompressedMatrix<T> &b = m2.row_compressed(storage2);
+        const size_t n_rows = m1.get_rows(), n_cols = m2.get_cols();
 
-            for (size_t i = 0; i < temp.size(); ++i)
-            {
-                if constexpr (OrderM2 == StorageOrder::RowMajor)
-                    temp[i] = m2(i, c);
-                else
-                    temp[i] = m2(c, i);
-            }
-
-            // trust the operator*(Matrix, vector)
-            result = m1 * temp;
-
-            // save values in the returning matrix
-            for (size_t i = 0; i < result.size(); ++i)
-            {
-                if (result[i] != 0)
-                    resultMatrix(i, c) = result[i];
-            }
+        // products of each row, to balance the blocks of rows
+        std::vector<size_t> products(n_rows + 1, 0);
+        for (size_t i = 0; i < n_rows; ++i)
+        {
+            size_t count = 0;
+            for (size_t j = a.inner_idx[i]; j < a.inner_idx[i + 1]; ++j)
+                count += b.inner_idx[a.outer_idx[j] + 1] - b.inner_idx[a.outer_idx[j]];
+            products[i + 1] = products[i] + count;
         }
+        const std::vector<size_t> bounds = balanced_partition(products, 1 << 15);
+        const size_t n_blocks = bounds.size() - 1;
+        constexpr size_t none = std::numeric_limits<size_t>::max();
+
+        Matrix<T, StorageOrder::RowMajor> resultMatrix(n_rows, n_cols);
+        CompressedMatrix<T> &c = resultMatrix.compressed_data;
+        c.inner_idx.assign(n_rows + 1, 0);
+        size_t *c_inner = c.inner_idx.begin();
+
+        // symbolic phase: number of non-zeros of each row, marker[col] is the last row which has col
+        for_each_block(n_blocks, [&](const size_t &blk)
+                       {
+                           std::vector<size_t> marker(n_cols, none);
+                           for (size_t i = bounds[blk]; i < bounds[blk + 1]; ++i)
+                           {
+                               size_t count = 0;
+                               for (size_t j = a.inner_idx[i]; j < a.inner_idx[i + 1]; ++j)
+                               {
+                                   const size_t k = a.outer_idx[j];
+                                   for (size_t l = b.inner_idx[k]; l < b.inner_idx[k + 1]; ++l)
+                                   {
+                                       if (marker[b.outer_idx[l]] != i)
+                                       {
+                                           marker[b.outer_idx[l]] = i;
+                                           ++count;
+                                       }
+                                   }
+                               }
+                               c_inner[i + 1] = count;
+                           } });
+
+        std::partial_sum(c.inner_idx.begin(), c.inner_idx.end(), c.inner_idx.begin());
+        c.outer_idx.resize(c.inner_idx.back());
+        c.data.resize(c.inner_idx.back());
+        size_t *c_outer = c.outer_idx.begin();
+        T *c_data = c.data.begin();
+
+        // numeric phase: each row is accumulated in a dense vector, its columns are sorted at the end
+        for_each_block(n_blocks, [&](const size_t &blk)
+                       {
+                           std::vector<size_t> marker(n_cols, none);
+                           std::vector<T> accumulator(n_cols);
+                           for (size_t i = bounds[blk]; i < bounds[blk + 1]; ++i)
+                           {
+                               size_t pos = c_inner[i];
+                               for (size_t j = a.inner_idx[i]; j < a.inner_idx[i + 1]; ++j)
+                               {
+                                   const size_t k = a.outer_idx[j];
+                                   const T value = a.data[j];
+                                   for (size_t l = b.inner_idx[k]; l < b.inner_idx[k + 1]; ++l)
+                                   {
+                                       const size_t col = b.outer_idx[l];
+                                       if (marker[col] != i)
+                                       {
+                                           marker[col] = i;
+                                           accumulator[col] = value * b.data[l];
+                                           c_outer[pos++] = col;
+                                       }
+                                       else
+                                           accumulator[col] += value * b.data[l];
+                                   }
+                               }
+
+                               std::sort(c_outer + c_inner[i], c_outer + pos);
+                               for (size_t p = c_inner[i]; p < pos; ++p)
+                                   c_data[p] = accumulator[c_outer[p]];
+                           } });
+
+        resultMatrix.compressed = true;
+        resultMatrix.partition_nonzeros();
 
         return resultMatrix;
     }
@@ -0,0 +1,165 @@
+#ifndef SELL_MATRIX_HPP
+#define SELL_MATRIX_HPP
+
+#include "Matrix.hpp"
+
+namespace algebra
+{
+
+    template <typename T, size_t C = 8, size_t Sigma = 256, typename Index = std::uint32_t>
+    class SellMatrix
+    {
+        /**
+         * @brief Sparse matrix in SELL-C-sigma format (sliced ELLPACK)
+         * @note The rows are sorted by length inside windows of Sigma rows, then grouped in slices of C rows; each slice is
+         * padded to its longest row and stored column by column, so the product updates C rows with each SIMD instruction.
+         * Column indexes and the permutation of the rows are of type Index (32 bits by default)
+         */
+
+        static_assert(C > 0 && Sigma % C == 0, "[SellMatrix] Sigma must be a multiple of C");
+        static_assert(std::is_unsigned_v<Index>, "[SellMatrix] Index must be an unsigned type");
+
+    private:
+        size_t rows = 0, cols = 0, nonzeros = 0;
+
+        std::vector<size_t> slice_ptr;  // first stored element of each slice, the last one is the total
+        std::vector<Index> slice_width; // number of columns of each slice
+        std::vector<Index> outer_idx;   // column of each stored element, padding elements repeat a valid column
+        std::vector<T> data;
+        std::vector<Index> perm; // original row of each sorted row
+        std::vector<size_t> bounds; // blocks of slices with about the same number of stored elements, one for each thread
+
+    public:
+        template <StorageOrder Order>
+        explicit SellMatrix(const Matrix<T, Order> &m)
+        {
+            /**
+             * @brief Constructor for the SellMatrix class
+             * @note The matrix is converted from its CSR format
+             * @param m The matrix, in any storage order, compressed or not
+             */
+
+            if (m.get_rows() > std::numeric_limits<Index>::max() || m.get_cols() > std::numeric_limits<Index>::max())
+                throw std::invalid_argument("[SellMatrix] The dimensions of the matrix do not fit in the index type");
+
+            CompressedMatrix<T> storage;
+            const CompressedMatrix<T> &csr = m.row_compressed(storage);
+            rows = m.get_rows();
+            cols = m.get_cols();
+            nonzeros = csr.outer_idx.size();
+
+            auto length = [&](const size_t &r)
+            { return csr.inner_idx[r + 1] - csr.inner_idx[r]; };
+
+            // sort the rows by decreasing length inside each window of Sigma rows
+            perm.resize(rows);
+            std::iota(perm.begin(), perm.end(), 0);
+            for (size_t w = 0; w < rows; w += Sigma)
+                std::stable_sort(perm.begin() + w, perm.begin() + std::min(w + Sigma, rows), [&](const Index &a, const Index &b)
+                                 { return length(a) > length(b); });
+
+            const size_t n_slices = (rows + C - 1) / C;
+            slice_ptr.assign(n_slices + 1, 0);
+            slice_width.assign(n_slices, 0);
+            for (size_t s = 0; s < n_slices; ++s)
+            {
+                // the rows are sorted, so the first row of the slice is the longest one
+                slice_width[s] = length(perm[s * C]);
+                slice_ptr[s + 1] = slice_ptr[s] + slice_width[s] * C;
+            }
+
+            outer_idx.assign(slice_ptr.back(), 0);
+            data.assign(slice_ptr.back(), 0);
+            for (size_t s = 0; s < n_slices; ++s)
+            {
+                for (size_t r = 0; r < C && s * C + r < rows; ++r)
+                {
+                    const size_t row = perm[s * C + r];
+                    const size_t begin = csr.inner_idx[row];
+                    for (size_t k = 0; k < slice_width[s]; ++k)
+                    {
+                        const size_t pos = slice_ptr[s] + k * C + r;
+                        if (k < length(row))
+                        {
+                            outer_idx[pos] = csr.outer_idx[begin + k];
+                            data[pos] = csr.data[begin + k];
+                        }
+                        else if (k > 0)
+                            outer_idx[pos] = outer_idx[pos - C]; // padding reads a column already in cache
+                    }
+                }
+            }
+
+            bounds = balanced_partition(slice_ptr, 1 << 15);
+        }
+
+        size_t get_rows() const noexcept { return rows; }
+        size_t get_cols() const noexcept { return cols; }
+        size_t get_nonzeros() const noexcept { return nonzeros; }
+        // stored elements over non-zeros, 1 without padding
+        double fill_ratio() const noexcept { return nonzeros ? static_cast<double>(data.size()) / nonzeros : 1; }
+
+        void multiply(std::span<const T> x, std::span<T> y) const
+        {
+            /**
+             * @brief Multiply the matrix by a vector, writing the result in a buffer of the caller
+             * @note The slices are split in blocks with the same number of stored elements, computed by the constructor, which run
+             * in parallel; the C rows of a slice are accumulated together with an omp simd loop
+             * @param x The vector, of size the number of columns
+             * @param y The result, of size the number of rows
+             */
+
+            if (x.size() != cols || y.size() != rows)
+                throw std::invalid_argument("[SellMatrix::multiply] The sizes of the vectors must be the number of columns and rows of the matrix");
+
+            for_each_block(bounds.size() - 1, [&](const size_t &b)
+                           {
+                               for (size_t s = bounds[b]; s < bounds[b + 1]; ++s)
+                               {
+                                   T sum[C] = {};
+                                   const Index *idx = outer_idx.data() + slice_ptr[s];
+                                   const T *values = data.data() + slice_ptr[s];
+                                   for (size_t k = 0; k < slice_width[s]; ++k)
+                                   {
+                                       #pragma omp simd
+                                       for (size_t r = 0; r < C; ++r)
+                                           sum[r] += values[k * C + r] * x[idx[k * C + r]];
+                                   }
+
+                                   for (size_t r = 0; r < C && s * C + r < rows; ++r)
+                                       y[perm[s * C + r]] = sum[r];
+                               } });
+        }
+    };
+
+    template <typename T, size_t C, size_t Sigma, typename Index>
+    void multiply(const SellMatrix<T, C, Sigma, Index> &m, std::span<const T> x, std::span<T> y)
+    {
+        /**
+         * @brief Multiply a matrix in SELL-C-sigma format by a vector, writing the result in a buffer of the caller
+         * @param m The matrix
+         * @param x The vector
+         * @param y The result
+         */
+
+        m.multiply(x, y);
+    }
+
+    template <typename T, size_t C, size_t Sigma, typename Index>
+    std::vector<T> operator*(const SellMatrix<T, C, Sigma, Index> &m, const std::vector<T> &v)
+    {
+        /**
+         * @brief Multiply a matrix in SELL-C-sigma format by a vector
+         * @param m The matrix
+         * @param v The vector
+         * @return The result of the multiplication
+         */
+
+        std::vector<T> result(m.get_rows(), 0);
+        m.multiply(v, result);
+        return result;
+    }
+
+}
+
+#endif
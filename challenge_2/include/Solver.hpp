@@ -0,0 +1,806 @@
+#ifndef SOLVER_HPP
+#define SOLVER_HPP
+
+#include "Matrix.hpp"
+
+#include <chrono>
+
+namespace algebra
+{
+
+    template <typename T>
+    class IdentityPreconditioner
+    {
+        /**
+         * @brief No preconditioning, z = r
+         * @note A diagonal preconditioner: the solvers apply it inside their vector passes
+         */
+
+    public:
+        static constexpr bool diagonal = true;
+
+        template <StorageOrder Order>
+        explicit IdentityPreconditioner(const Matrix<T, Order> &) noexcept {}
+
+        T operator[](const size_t &) const noexcept { return 1; }
+
+        void apply(std::span<const T> r, std::span<T> z) const noexcept { std::copy(r.begin(), r.end(), z.begin()); }
+    };
+
+    template <typename T>
+    class JacobiPreconditioner
+    {
+        /**
+         * @brief Jacobi preconditioner, z = D^-1 r with D the diagonal of the matrix
+         * @note A diagonal preconditioner: the solvers apply it inside their vector passes
+         */
+
+    private:
+        std::vector<T> inv_diag;
+
+    public:
+        static constexpr bool diagonal = true;
+
+        template <StorageOrder Order>
+        explicit JacobiPreconditioner(const Matrix<T, Order> &m)
+        {
+            /**
+             * @brief Constructor for the JacobiPreconditioner class
+             * @note The diagonal is read from the CSR format of the matrix
+             * @param m The square matrix, in any storage order, compressed or not
+             */
+
+            if (m.get_rows() != m.get_cols())
+                throw std::invalid_argument("[JacobiPreconditioner] The matrix must be square");
+
+            CompressedMatrix<T> storage;
+            const CompressedMatrix<T> &csr = m.row_compressed(storage);
+            inv_diag.assign(m.get_rows(), 0);
+            for (size_t i = 0; i < inv_diag.size(); ++i)
+            {
+                for (size_t j = csr.inner_idx[i]; j < csr.inner_idx[i + 1]; ++j)
+                {
+                    if (csr.outer_idx[j] == i)
+                        inv_diag[i] += csr.data[j];
+                }
+
+                if (inv_diag[i] == T(0))
+                    throw std::runtime_error("[JacobiPreconditioner] Zero on the diagonal of row " + std::to_string(i));
+                inv_diag[i] = T(1) / inv_diag[i];
+            }
+        }
+
+        T operator[](const size_t &i) const noexcept { return inv_diag[i]; }
+
+        void apply(std::span<const T> r, std::span<T> z) const noexcept
+        {
+            #pragma omp simd
+            for (size_t i = 0; i < r.size(); ++i)
+                z[i] = inv_diag[i] * r[i];
+        }
+    };
+
+    template <typename T>
+    class ILU0Preconditioner
+    {
+        /**
+         * @brief Incomplete LU factorisation without fill-in, z = (LU)^-1 r
+         * @note L (unit lower) and U are stored together in the pattern of the matrix, in CSR format; the triangular
+         * solves are sequential
+         */
+
+    private:
+        CompressedMatrix<T> lu;
+        std::vector<size_t> diag; // position of the diagonal of each row in lu
+
+    public:
+        static constexpr bool diagonal = false;
+
+        template <StorageOrder Order>
+        explicit ILU0Preconditioner(const Matrix<T, Order> &m)
+        {
+            /**
+             * @brief Constructor for the ILU0Preconditioner class
+             * @note The factorisation is the IKJ variant on the CSR format of the matrix, O(nnz * non-zeros per row):
+             * each row subtracts the previous rows of its lower part, keeping only the positions of the matrix
+             * @param m The square matrix, in any storage order, compressed or not, with every diagonal entry
+             */
+
+            if (m.get_rows() != m.get_cols())
+                throw std::invalid_argument("[ILU0Preconditioner] The matrix must be square");
+
+            CompressedMatrix<T> storage;
+            const CompressedMatrix<T> &csr = m.row_compressed(storage);
+            if (&csr == &storage)
+                lu = std::move(storage);
+            else
+                lu = csr;
+
+            const size_t n = m.get_rows();
+            diag.resize(n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                // the columns of each row are sorted
+                const auto first = lu.outer_idx.begin() + lu.inner_idx[i], last = lu.outer_idx.begin() + lu.inner_idx[i + 1];
+                const auto it = std::lower_bound(first, last, i);
+                if (it == last || *it != i)
+                    throw std::runtime_error("[ILU0Preconditioner] Missing diagonal in row " + std::to_string(i));
+                diag[i] = it - lu.outer_idx.begin();
+            }
+
+            constexpr size_t none = std::numeric_limits<size_t>::max();
+            // position of each column in the current row
+            std::vector<size_t> position(n, none);
+            for (size_t i = 0; i < n; ++i)
+            {
+                for (size_t j = lu.inner_idx[i]; j < lu.inner_idx[i + 1]; ++j)
+                    position[lu.outer_idx[j]] = j;
+
+                for (size_t j = lu.inner_idx[i]; j < diag[i]; ++j)
+                {
+                    const size_t k = lu.outer_idx[j];
+                    lu.data[j] /= lu.data[diag[k]];
+                    for (size_t l = diag[k] + 1; l < lu.inner_idx[k + 1]; ++l)
+                    {
+                        if (position[lu.outer_idx[l]] != none)
+                            lu.data[position[lu.outer_idx[l]]] -= lu.data[j] * lu.data[l];
+                    }
+                }
+
+                if (lu.data[diag[i]] == T(0))
+                    throw std::runtime_error("[ILU0Preconditioner] Zero pivot in row " + std::to_string(i));
+
+                for (size_t j = lu.inner_idx[i]; j < lu.inner_idx[i + 1]; ++j)
+                    position[lu.outer_idx[j]] = none;
+            }
+        }
+
+        void apply(std::span<const T> r, std::span<T> z) const noexcept
+        {
+            /**
+             * @brief Solve L U z = r
+             * @note A forward substitution with L then a backward one with U, in place in z
+             * @param r The vector
+             * @param z The result, of the same size
+             */
+
+            const size_t n = diag.size();
+            for (size_t i = 0; i < n; ++i)
+            {
+                T sum = r[i];
+                for (size_t j = lu.inner_idx[i]; j < diag[i]; ++j)
+                    sum -= lu.data[j] * z[lu.outer_idx[j]];
+                z[i] = sum;
+            }
+
+            for (size_t i = n; i-- > 0;)
+            {
+                T sum = z[i];
+                for (size_t j = diag[i] + 1; j < lu.inner_idx[i + 1]; ++j)
+                    sum -= lu.data[j] * z[lu.outer_idx[j]];
+                z[i] = sum / lu.data[diag[i]];
+            }
+        }
+    };
+
+    struct SolverReport
+    {
+        bool converged = false;        // the residual of the method reached the tolerance
+        size_t iterations = 0;         // iterations done (products by the matrix for GMRES)
+        double residual = 0;           // true relative residual ||b - A x|| / ||b|| of the solution
+        std::vector<double> residuals; // relative residual of the method, the first one is the initial residual
+        std::vector<double> times;     // milliseconds since the start of the solve, for each residual
+    };
+
+    template <typename T>
+    Matrix<T, StorageOrder::RowMajor> laplacian(const size_t &n)
+    {
+        /**
+         * @brief Assemble the 5-point finite differences matrix of -Laplacian on the unit square with Dirichlet boundary
+         * @note The mesh is the one of challenge_3, n points per side with h = 1 / (n - 1): the unknowns are the
+         * (n - 2)^2 interior points, numbered row by row, and the boundary values go in the right-hand side. The matrix is
+         * symmetric positive definite
+         * @param n The number of points of each side, boundary included
+         * @return The compressed matrix
+         */
+
+        if (n < 3)
+            throw std::invalid_argument("[laplacian] The mesh must have at least 3 points per side");
+
+        const size_t m = n - 2;
+        const T inv_h2 = static_cast<T>((n - 1) * (n - 1));
+        Matrix<T, StorageOrder::RowMajor> A(m * m, m * m);
+        A.reserve(5 * m * m);
+        for (size_t i = 0; i < m; ++i)
+        {
+            for (size_t j = 0; j < m; ++j)
+            {
+                const size_t k = i * m + j;
+                if (i > 0)
+                    A.insert(k, k - m, -inv_h2);
+                if (j > 0)
+                    A.insert(k, k - 1, -inv_h2);
+                A.insert(k, k, 4 * inv_h2);
+                if (j + 1 < m)
+                    A.insert(k, k + 1, -inv_h2);
+                if (i + 1 < m)
+                    A.insert(k, k + m, -inv_h2);
+            }
+        }
+
+        A.compress();
+        return A;
+    }
+
+    template <typename T, StorageOrder Order, typename Preconditioner = IdentityPreconditioner<T>>
+    class IterativeSolver
+    {
+        /**
+         * @brief Krylov solvers of A x = b with a compressed matrix A: CG, BiCGSTAB and restarted GMRES
+         * @note The work vectors are allocated once and reused by every solve, the products by the matrix use the
+         * parallel multiply with the workspace of the solver and the vector updates are fused with the dot products which
+         * follow them, in one parallel pass over blocks of the vectors; a diagonal preconditioner is applied in the same passes
+         */
+
+        using clock = std::chrono::steady_clock;
+        // dot products computed by a fused pass
+        using Sums = std::array<T, 3>;
+
+    private:
+        const Matrix<T, Order> &A;
+        Preconditioner M;
+        size_t n = 0;
+
+        double tolerance = 1e-8;
+        size_t max_iterations = 1000;
+        size_t restart = 30;
+        bool verbose = false;
+
+        // blocks of the vectors, with the partial sums of each block
+        std::vector<size_t> bounds;
+        std::vector<Sums> partial;
+
+        // scratch of the products by A, of the solver so that solvers which share A can run at the same time
+        ProductWorkspace<T> workspace;
+
+        std::vector<T> r, z, p, q, r_hat, s, t, v;
+        // GMRES: Krylov basis, Hessenberg matrix (column by column), Givens rotations and right-hand side
+        std::vector<T> basis, hessenberg, cs, sn, g;
+
+        template <typename Kernel>
+        Sums fused(Kernel &&kernel)
+        {
+            /**
+             * @brief Run a pass over the vectors in parallel blocks
+             * @note The partial sums of the blocks are added in order, so the result does not depend on the threads
+             * @param kernel The function called with the range [begin, end) of each block, returning its sums
+             * @return The sums of the whole vectors
+             */
+
+            for_each_block(bounds.size() - 1, [&](const size_t &b)
+                           { partial[b] = kernel(bounds[b], bounds[b + 1]); });
+
+            Sums sums = {};
+            for (const auto &part : partial)
+                for (size_t i = 0; i < sums.size(); ++i)
+                    sums[i] += part[i];
+            return sums;
+        }
+
+        T dot(const T *x, const T *y)
+        {
+            return fused([&](const size_t &begin, const size_t &end)
+                         {
+                             T sum = 0;
+                             #pragma omp simd reduction(+ : sum)
+                             for (size_t i = begin; i < end; ++i)
+                                 sum += x[i] * y[i];
+                             return Sums{sum, 0, 0}; })[0];
+        }
+
+        void check_sizes(std::span<const T> b, std::span<T> x, const std::string &name) const
+        {
+            if (b.size() != n || x.size() != n)
+                throw std::invalid_argument("[" + name + "] The sizes of b and x must be the size of the matrix");
+        }
+
+        bool record(SolverReport &report, const double &residual, const clock::time_point &start, const std::string &name) const
+        {
+            /**
+             * @brief Save the residual and the time of an iteration, printing them in verbose mode
+             * @return Whether the residual reached the tolerance
+             */
+
+            const double elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            report.residuals.push_back(residual);
+            report.times.push_back(elapsed);
+            if (verbose)
+                std::cout << "[" << name << "] iteration " << report.iterations << " residual " << residual << " time " << elapsed << " ms" << std::endl;
+            return residual <= tolerance;
+        }
+
+        bool initial_residual(std::span<const T> b, std::span<T> x, SolverReport &report, T &b_norm)
+        {
+            /**
+             * @brief Compute r = b - A x and ||b||
+             * @note A zero right-hand side has the zero solution, written in x
+             * @return Whether the solve is over
+             */
+
+            const T *b_ = b.data();
+            T *r_ = r.data(), *q_ = q.data();
+            multiply(A, std::span<const T>(x), std::span<T>(q), workspace);
+            const Sums sums = fused([&](const size_t &begin, const size_t &end)
+                                    {
+                                        T bb = 0, rr = 0;
+                                        #pragma omp simd reduction(+ : bb, rr)
+                                        for (size_t i = begin; i < end; ++i)
+                                        {
+                                            r_[i] = b_[i] - q_[i];
+                                            bb += b_[i] * b_[i];
+                                            rr += r_[i] * r_[i];
+                                        }
+                                        return Sums{bb, rr, 0}; });
+
+            b_norm = std::sqrt(sums[0]);
+            if (b_norm == T(0))
+            {
+                std::fill(x.begin(), x.end(), 0);
+                report.converged = true;
+                report.residuals.push_back(0);
+                report.times.push_back(0);
+                return true;
+            }
+
+            return false;
+        }
+
+        void true_residual(std::span<const T> b, std::span<const T> x, SolverReport &report, const T &b_norm)
+        {
+            /**
+             * @brief Save the relative residual ||b - A x|| / ||b|| of the solution, which the recurrences only estimate
+             */
+
+            if (b_norm == T(0))
+                return;
+
+            const T *b_ = b.data(), *q_ = q.data();
+            multiply(A, x, std::span<T>(q), workspace);
+            const Sums sums = fused([&](const size_t &begin, const size_t &end)
+                                    {
+                                        T rr = 0;
+                                        #pragma omp simd reduction(+ : rr)
+                                        for (size_t i = begin; i < end; ++i)
+                                            rr += (b_[i] - q_[i]) * (b_[i] - q_[i]);
+                                        return Sums{rr, 0, 0}; });
+            report.residual = std::sqrt(sums[0]) / b_norm;
+        }
+
+    public:
+        explicit IterativeSolver(const Matrix<T, Order> &matrix) : A(matrix), M(matrix), n(matrix.get_rows())
+        {
+            /**
+             * @brief Constructor for the IterativeSolver class
+             * @note The preconditioner is built from the matrix; the matrix is referenced, not copied, and must
+             * outlive the solver
+             * @param matrix The square compressed matrix
+             */
+
+            if (!A.is_compressed())
+                throw std::invalid_argument("[IterativeSolver] The matrix must be compressed");
+            if (A.get_rows() != A.get_cols())
+                throw std::invalid_argument("[IterativeSolver] The matrix must be square");
+
+            // blocks of at least 16384 elements of each vector
+            std::vector<size_t> prefix(n + 1);
+            std::iota(prefix.begin(), prefix.end(), 0);
+            bounds = balanced_partition(prefix, 1 << 14);
+            partial.resize(bounds.size() - 1);
+
+            r.resize(n);
+            z.resize(n);
+            p.resize(n);
+            q.resize(n);
+        }
+
+        void set_tolerance(const double &tol) noexcept { tolerance = tol; }
+        void set_max_iterations(const size_t &iterations) noexcept { max_iterations = iterations; }
+        void set_restart(const size_t &m) noexcept { restart = std::max<size_t>(m, 1); }
+        void set_verbose(const bool &v) noexcept { verbose = v; }
+        const Preconditioner &get_preconditioner() const noexcept { return M; }
+
+        SolverReport cg(std::span<const T> b, std::span<T> x)
+        {
+            /**
+             * @brief Solve A x = b with the preconditioned Conjugate Gradient, for symmetric positive definite matrices
+             * @note Each iteration is a product by the matrix and three passes over the vectors: p . A p, the update of x
+             * and r fused with r . r and (with a diagonal preconditioner) z = M^-1 r and r . z, then p = z + beta p
+             * @param b The right-hand side
+             * @param x The initial guess, overwritten by the solution
+             * @return The residuals and times of the iterations
+             */
+
+            check_sizes(b, x, "IterativeSolver::cg");
+            const auto start = clock::now();
+            SolverReport report;
+            T b_norm = 0;
+            if (initial_residual(b, x, report, b_norm))
+                return report;
+
+            T *x_ = x.data(), *r_ = r.data(), *z_ = z.data(), *p_ = p.data(), *q_ = q.data();
+            const Preconditioner &M_ = M;
+
+            // z = M^-1 r, p = z
+            auto precondition = [&]()
+            {
+                if constexpr (!Preconditioner::diagonal)
+                    M_.apply(r, z);
+                return fused([&](const size_t &begin, const size_t &end)
+                             {
+                                 T rr = 0, rz = 0;
+                                 #pragma omp simd reduction(+ : rr, rz)
+                                 for (size_t i = begin; i < end; ++i)
+                                 {
+                                     if constexpr (Preconditioner::diagonal)
+                                         z_[i] = M_[i] * r_[i];
+                                     rr += r_[i] * r_[i];
+                                     rz += r_[i] * z_[i];
+                                 }
+                                 return Sums{rr, rz, 0}; });
+            };
+
+            Sums sums = precondition();
+            std::copy(z.begin(), z.end(), p.begin());
+            T rz = sums[1];
+
+            report.converged = record(report, std::sqrt(sums[0]) / b_norm, start, "cg");
+            while (!report.converged && report.iterations < max_iterations)
+            {
+                multiply(A, std::span<const T>(p), std::span<T>(q), workspace);
+                const T pq = dot(p_, q_);
+                if (pq == T(0))
+                    break;
+                const T alpha = rz / pq;
+
+                // x += alpha p, r -= alpha A p, z = M^-1 r
+                sums = fused([&](const size_t &begin, const size_t &end)
+                             {
+                                 T rr = 0, rz_new = 0;
+                                 #pragma omp simd reduction(+ : rr, rz_new)
+                                 for (size_t i = begin; i < end; ++i)
+                                 {
+                                     x_[i] += alpha * p_[i];
+                                     r_[i] -= alpha * q_[i];
+                                     rr += r_[i] * r_[i];
+                                     if constexpr (Preconditioner::diagonal)
+                                     {
+                                         z_[i] = M_[i] * r_[i];
+                                         rz_new += r_[i] * z_[i];
+                                     }
+                                 }
+                                 return Sums{rr, rz_new, 0}; });
+                ++report.iterations;
+                report.converged = record(report, std::sqrt(sums[0]) / b_norm, start, "cg");
+                if (report.converged)
+                    break;
+
+                if constexpr (!Preconditioner::diagonal)
+                    sums = precondition();
+                const T beta = sums[1] / rz;
+                rz = sums[1];
+
+                fused([&](const size_t &begin, const size_t &end)
+                      {
+                          #pragma omp simd
+                          for (size_t i = begin; i < end; ++i)
+                              p_[i] = z_[i] + beta * p_[i];
+                          return Sums{}; });
+            }
+
+            true_residual(b, x, report, b_norm);
+            return report;
+        }
+
+        SolverReport bicgstab(std::span<const T> b, std::span<T> x)
+        {
+            /**
+             * @brief Solve A x = b with the right preconditioned BiCGSTAB, for general matrices
+             * @note Each iteration is two products by the matrix and two preconditioner applications; the updates of p,
+             * s and of x with r are fused with the dot products which follow them. A breakdown (a zero denominator)
+             * stops the iterations without convergence
+             * @param b The right-hand side
+             * @param x The initial guess, overwritten by the solution
+             * @return The residuals and times of the iterations
+             */
+
+            check_sizes(b, x, "IterativeSolver::bicgstab");
+            const auto start = clock::now();
+            SolverReport report;
+            T b_norm = 0;
+            r_hat.resize(n);
+            s.resize(n);
+            t.resize(n);
+            v.resize(n);
+            if (initial_residual(b, x, report, b_norm))
+                return report;
+
+            // z and q hold p_hat = M^-1 p and s_hat = M^-1 s
+            T *x_ = x.data(), *r_ = r.data(), *r_hat_ = r_hat.data(), *p_ = p.data(), *v_ = v.data();
+            T *s_ = s.data(), *t_ = t.data(), *p_hat_ = z.data(), *s_hat_ = q.data();
+            const Preconditioner &M_ = M;
+
+            std::copy(r.begin(), r.end(), r_hat.begin());
+            std::fill(p.begin(), p.end(), 0);
+            std::fill(v.begin(), v.end(), 0);
+            T rho = dot(r_, r_), alpha = 1, omega = 1, beta = 0;
+
+            report.converged = record(report, std::sqrt(rho) / b_norm, start, "bicgstab");
+            while (!report.converged && report.iterations < max_iterations && rho != T(0))
+            {
+                // p = r + beta (p - omega v), p_hat = M^-1 p
+                fused([&](const size_t &begin, const size_t &end)
+                      {
+                          #pragma omp simd
+                          for (size_t i = begin; i < end; ++i)
+                          {
+                              p_[i] = r_[i] + beta * (p_[i] - omega * v_[i]);
+                              if constexpr (Preconditioner::diagonal)
+                                  p_hat_[i] = M_[i] * p_[i];
+                          }
+                          return Sums{}; });
+                if constexpr (!Preconditioner::diagonal)
+                    M_.apply(p, z);
+
+                multiply(A, std::span<const T>(z), std::span<T>(v), workspace);
+                const T r_hat_v = dot(r_hat_, v_);
+                if (r_hat_v == T(0))
+                    break;
+                alpha = rho / r_hat_v;
+
+                // s = r - alpha v, s_hat = M^-1 s
+                Sums sums = fused([&](const size_t &begin, const size_t &end)
+                                  {
+                                      T ss = 0;
+                                      #pragma omp simd reduction(+ : ss)
+                                      for (size_t i = begin; i < end; ++i)
+                                      {
+                                          s_[i] = r_[i] - alpha * v_[i];
+                                          ss += s_[i] * s_[i];
+                                          if constexpr (Preconditioner::diagonal)
+                                              s_hat_[i] = M_[i] * s_[i];
+                                      }
+                                      return Sums{ss, 0, 0}; });
+
+                // the half step already converged: x += alpha p_hat
+                if (std::sqrt(sums[0]) / b_norm <= tolerance)
+                {
+                    fused([&](const size_t &begin, const size_t &end)
+                          {
+                              #pragma omp simd
+                              for (size_t i = begin; i < end; ++i)
+                                  x_[i] += alpha * p_hat_[i];
+                              return Sums{}; });
+                    ++report.iterations;
+                    report.converged = record(report, std::sqrt(sums[0]) / b_norm, start, "bicgstab");
+                    break;
+                }
+
+                if constexpr (!Preconditioner::diagonal)
+                    M_.apply(s, q);
+                multiply(A, std::span<const T>(q), std::span<T>(t), workspace);
+                sums = fused([&](const size_t &begin, const size_t &end)
+                             {
+                                 T tt = 0, ts = 0;
+                                 #pragma omp simd reduction(+ : tt, ts)
+                                 for (size_t i = begin; i < end; ++i)
+                                 {
+                                     tt += t_[i] * t_[i];
+                                     ts += t_[i] * s_[i];
+                                 }
+                                 return Sums{tt, ts, 0}; });
+                if (sums[0] == T(0))
+                    break;
+                omega = sums[1] / sums[0];
+
+                // x += alpha p_hat + omega s_hat, r = s - omega t
+                sums = fused([&](const size_t &begin, const size_t &end)
+                             {
+                                 T rr = 0, rho_new = 0;
+                                 #pragma omp simd reduction(+ : rr, rho_new)
+                                 for (size_t i = begin; i < end; ++i)
+                                 {
+                                     x_[i] += alpha * p_hat_[i] + omega * s_hat_[i];
+                                     r_[i] = s_[i] - omega * t_[i];
+                                     rr += r_[i] * r_[i];
+                                     rho_new += r_hat_[i] * r_[i];
+                                 }
+                                 return Sums{rr, rho_new, 0}; });
+                ++report.iterations;
+                report.converged = record(report, std::sqrt(sums[0]) / b_norm, start, "bicgstab");
+                if (omega == T(0))
+                    break;
+
+                beta = (sums[1] / rho) * (alpha / omega);
+                rho = sums[1];
+            }
+
+            true_residual(b, x, report, b_norm);
+            return report;
+        }
+
+        SolverReport gmres(std::span<const T> b, std::span<T> x)
+        {
+            /**
+             * @brief Solve A x = b with the right preconditioned GMRES restarted every restart iterations, for general matrices
+             * @note The basis is orthogonalised with the modified Gram-Schmidt method, each subtraction of a vector fused
+             * with the dot product by the next one, and the least squares problem is updated with Givens rotations, whose
+             * last component is the residual of each iteration. Each restart computes the true residual
+             * @param b The right-hand side
+             * @param x The initial guess, overwritten by the solution
+             * @return The residuals and times of the iterations
+             */
+
+            check_sizes(b, x, "IterativeSolver::gmres");
+            const auto start = clock::now();
+            SolverReport report;
+            T b_norm = 0;
+            const size_t m = restart;
+            basis.resize((m + 1) * n);
+            hessenberg.resize((m + 1) * m);
+            cs.resize(m);
+            sn.resize(m);
+            g.resize(m + 1);
+            if (initial_residual(b, x, report, b_norm))
+                return report;
+
+            T *x_ = x.data(), *r_ = r.data(), *z_ = z.data(), *q_ = q.data();
+            const Preconditioner &M_ = M;
+
+            // z = M^-1 w
+            auto precondition = [&](const T *w)
+            {
+                if constexpr (Preconditioner::diagonal)
+                    fused([&](const size_t &begin, const size_t &end)
+                          {
+                              #pragma omp simd
+                              for (size_t i = begin; i < end; ++i)
+                                  z_[i] = M_[i] * w[i];
+                              return Sums{}; });
+                else
+                    M_.apply(std::span<const T>(w, n), z);
+            };
+
+            bool first = true;
+            while (true)
+            {
+                // r = b - A x, the first one is computed by initial_residual
+                if (!first)
+                {
+                    multiply(A, std::span<const T>(x), std::span<T>(q), workspace);
+                    fused([&](const size_t &begin, const size_t &end)
+                          {
+                              #pragma omp simd
+                              for (size_t i = begin; i < end; ++i)
+                                  r_[i] = b[i] - q_[i];
+                              return Sums{}; });
+                }
+                const T beta = std::sqrt(dot(r_, r_));
+                if (first)
+                    report.converged = record(report, beta / b_norm, start, "gmres");
+                else
+                    report.converged = beta / b_norm <= tolerance;
+                first = false;
+                if (report.converged || report.iterations >= max_iterations)
+                    break;
+
+                T *v0 = basis.data();
+                fused([&](const size_t &begin, const size_t &end)
+                      {
+                          #pragma omp simd
+                          for (size_t i = begin; i < end; ++i)
+                              v0[i] = r_[i] / beta;
+                          return Sums{}; });
+                std::fill(g.begin(), g.end(), 0);
+                g[0] = beta;
+
+                size_t j = 0;
+                bool estimate_converged = false;
+                while (j < m && report.iterations < max_iterations)
+                {
+                    // w = A M^-1 v_j, written in the place of v_(j+1)
+                    T *h = hessenberg.data() + j * (m + 1);
+                    T *w = basis.data() + (j + 1) * n;
+                    precondition(basis.data() + j * n);
+                    multiply(A, std::span<const T>(z), std::span<T>(w, n), workspace);
+
+                    h[0] = dot(w, basis.data());
+                    for (size_t i = 0; i <= j; ++i)
+                    {
+                        // w -= h_i v_i with w . v_(i+1), or w . w after the last one
+                        const T *v_i = basis.data() + i * n;
+                        const T *v_next = i < j ? basis.data() + (i + 1) * n : w;
+                        const T h_i = h[i];
+                        h[i + 1] = fused([&](const size_t &begin, const size_t &end)
+                                         {
+                                             T sum = 0;
+                                             #pragma omp simd reduction(+ : sum)
+                                             for (size_t k = begin; k < end; ++k)
+                                             {
+                                                 w[k] -= h_i * v_i[k];
+                                                 sum += w[k] * v_next[k];
+                                             }
+                                             return Sums{sum, 0, 0}; })[0];
+                    }
+                    h[j + 1] = std::sqrt(h[j + 1]);
+
+                    // a zero norm means the solution is in the basis
+                    const bool breakdown = h[j + 1] == T(0);
+                    if (!breakdown)
+                    {
+                        const T inv_norm = T(1) / h[j + 1];
+                        fused([&](const size_t &begin, const size_t &end)
+                              {
+                                  #pragma omp simd
+                                  for (size_t k = begin; k < end; ++k)
+                                      w[k] *= inv_norm;
+                                  return Sums{}; });
+                    }
+
+                    for (size_t i = 0; i < j; ++i)
+                    {
+                        const T temp = cs[i] * h[i] + sn[i] * h[i + 1];
+                        h[i + 1] = -sn[i] * h[i] + cs[i] * h[i + 1];
+                        h[i] = temp;
+                    }
+                    const T denominator = std::hypot(h[j], h[j + 1]);
+                    cs[j] = h[j] / denominator;
+                    sn[j] = h[j + 1] / denominator;
+                    h[j] = denominator;
+                    h[j + 1] = 0;
+                    g[j + 1] = -sn[j] * g[j];
+                    g[j] = cs[j] * g[j];
+
+                    ++j;
+                    ++report.iterations;
+                    estimate_converged = record(report, std::abs(g[j]) / b_norm, start, "gmres");
+                    if (estimate_converged || breakdown)
+                        break;
+                }
+
+                // y = H^-1 g in g, then x += M^-1 V y
+                for (size_t i = j; i-- > 0;)
+                {
+                    for (size_t k = i + 1; k < j; ++k)
+                        g[i] -= hessenberg[k * (m + 1) + i] * g[k];
+                    g[i] /= hessenberg[i * (m + 1) + i];
+                }
+                fused([&](const size_t &begin, const size_t &end)
+                      {
+                          for (size_t k = begin; k < end; ++k)
+                              q_[k] = 0;
+                          for (size_t i = 0; i < j; ++i)
+                          {
+                              const T *v_i = basis.data() + i * n;
+                              const T y_i = g[i];
+                              #pragma omp simd
+                              for (size_t k = begin; k < end; ++k)
+                                  q_[k] += y_i * v_i[k];
+                          }
+                          return Sums{}; });
+                precondition(q_);
+                fused([&](const size_t &begin, const size_t &end)
+                      {
+                          #pragma omp simd
+                          for (size_t k = begin; k < end; ++k)
+                              x_[k] += z_[k];
+                          return Sums{}; });
+            }
+
+            true_residual(b, x, report, b_norm);
+            return report;
+        }
+    };
+
+}
+
+#endif
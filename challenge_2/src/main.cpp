@@ -1,4 +1,5 @@
 #include "Matrix.hpp"
+#include "Solver.hpp"
 
 #include <chrono>
 
@@ -72,6 +73,29 @@ void prod_matrix_matrix(auto &m, size_t n_cols = 2)
   //m_temp.print();
 }
 
+void prod_matrix_dense(auto &m, size_t n_cols = 2)
+{
+  /**
+   * @brief function to test the product of a matrix with a dense block of vectors
+   * @note the function will print the time taken by the operation, which reads the matrix once for all the columns
+   * @param m first matrix to multiply
+   * @param n_cols number of columns of the dense matrix
+   */
+
+  algebra::DenseMatrix<double> x(m.get_cols(), n_cols, 1);
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  auto result = m * x;
+
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+
+  // printing the time
+  std::string placeholder = m.is_compressed() ? "Compressed: " : "Uncompressed: ";
+  std::cout << "[Matrix-Dense] "<< placeholder << duration.count() << " mus" << std::endl;
+}
+
 void norm_test(auto &m)
 {
   /**
@@ -103,20 +127,141 @@ void norm_test(auto &m)
   std::cout << "Norm - Frobenius: " << m.template norm<algebra::norm_type::Frobenius>() << std::endl;
 }
 
+void reorder_test(const auto &m, const int &runs = 20)
+{
+  /**
+   * @brief function to test the product of a compressed matrix with a vector before and after the Reverse Cuthill-McKee reordering
+   * @note the function will print the bandwidth, the time of the reordering and the average time of the products
+   * (the reordered product permutes the vectors too)
+   * @param m the compressed matrix to test
+   * @param runs the number of products to average
+   */
+
+  if (m.get_rows() != m.get_cols())
+  {
+    std::cout << "[Reordering] Only square matrices can be reordered" << std::endl;
+    return;
+  }
+
+  auto reordered = m;
+  auto start = std::chrono::high_resolution_clock::now();
+  reordered.compress(algebra::RCM);
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+
+  std::vector<double> v(m.get_cols(), 1), result(m.get_rows());
+  auto time = [&](const auto &matrix)
+  {
+    algebra::ProductWorkspace<double> workspace;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < runs; i++)
+      algebra::multiply(matrix, std::span<const double>(v), std::span<double>(result), workspace);
+    auto stop = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() / runs;
+  };
+
+  std::cout << "[Reordering] RCM: " << duration.count() << " mus, bandwidth " << m.bandwidth() << " -> " << reordered.bandwidth() << std::endl;
+  std::cout << "[Matrix-Vector] Compressed: " << time(m) << " mus, reordered: " << time(reordered) << " mus" << std::endl;
+}
+
+template <typename Preconditioner>
+void solve_test(const algebra::Matrix<double, algebra::StorageOrder::RowMajor> &A, const std::vector<double> &b, const std::vector<double> &exact, const std::string &name, const int &method)
+{
+  /**
+   * @brief function to test an iterative solver on a linear system
+   * @note the function will print the iterations, the residual, the time taken by the solve and the maximum error from the exact solution
+   * @param A the compressed matrix of the system
+   * @param b the right-hand side
+   * @param exact the exact solution, to compute the error
+   * @param name the name of the preconditioner
+   * @param method 0 for CG, 1 for BiCGSTAB, 2 for GMRES
+   */
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  algebra::IterativeSolver<double, algebra::StorageOrder::RowMajor, Preconditioner> solver(A);
+  solver.set_tolerance(1e-10);
+  solver.set_max_iterations(10000);
+  std::vector<double> x(b.size(), 0);
+  algebra::SolverReport report = method == 0 ? solver.cg(b, x) : method == 1 ? solver.bicgstab(b, x) : solver.gmres(b, x);
+
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+
+  double error = 0;
+  for (size_t i = 0; i < x.size(); i++)
+    error = std::max(error, std::abs(x[i] - exact[i]));
+
+  const std::string methods[] = {"CG", "BiCGSTAB", "GMRES"};
+  std::cout << "[" << methods[method] << "-" << name << "] " << report.iterations << " iterations, residual " << report.residual
+            << ", error " << error << ", " << duration.count() << " ms" << (report.converged ? "" : " (not converged)") << std::endl;
+}
+
+void laplace_test(const size_t &n)
+{
+  /**
+   * @brief function to test the iterative solvers on a Laplace problem assembled like the one of challenge_3
+   * @note -Laplacian(u) = 0 on the unit square with u = exp(x) sin(y) on the boundary, on a mesh of n points per side:
+   * the exact solution is exp(x) sin(y) and the boundary values move to the right-hand side
+   * @param n the number of points of each side of the mesh
+   */
+
+  const algebra::Matrix<double, algebra::StorageOrder::RowMajor> A = algebra::laplacian<double>(n);
+  const size_t m = n - 2;
+  const double h = 1.0 / (n - 1);
+  auto u = [h](const size_t &i, const size_t &j)
+  { return std::exp(j * h) * std::sin(i * h); };
+
+  std::vector<double> b(m * m, 0), exact(m * m);
+  for (size_t i = 1; i <= m; i++)
+  {
+    for (size_t j = 1; j <= m; j++)
+    {
+      const size_t k = (i - 1) * m + j - 1;
+      exact[k] = u(i, j);
+      // neighbours on the boundary
+      if (i == 1)
+        b[k] += u(0, j) / (h * h);
+      if (i == m)
+        b[k] += u(n - 1, j) / (h * h);
+      if (j == 1)
+        b[k] += u(i, 0) / (h * h);
+      if (j == m)
+        b[k] += u(i, n - 1) / (h * h);
+    }
+  }
+
+  std::cout << std::endl
+            << "Laplace problem, " << n << " points per side" << std::endl;
+  for (int method = 0; method < 3; method++)
+  {
+    solve_test<algebra::JacobiPreconditioner<double>>(A, b, exact, "Jacobi", method);
+    solve_test<algebra::ILU0Preconditioner<double>>(A, b, exact, "ILU0", method);
+  }
+}
+
 int main(int argc, char *argv[])
 {
 
   if (argc == 1)
   {
-    std::cout << "Usage: ./main <filename matrix 1>" << std::endl;
+    std::cout << "Usage: ./main <filename matrix 1> [--laplace]" << std::endl;
     return 1;
   }
-  else if (argc > 2)
+  else if (argc > 3)
   {
     std::cout << "Too many arguments" << std::endl;
     return 1;
   }
 
+  // the iterative solvers on the Laplace problem run only on request, they take much longer than the products
+  const bool laplace = argc == 3 && std::string(argv[2]) == "--laplace";
+  if (argc == 3 && !laplace)
+  {
+    std::cout << "Unknown option " << argv[2] << std::endl;
+    return 1;
+  }
+
   std::string filename = argv[1];
 
   //algebra::Matrix<double, algebra::StorageOrder::ColumnMajor> m(filename);
@@ -124,14 +269,21 @@ int main(int argc, char *argv[])
 
   prod_matrix_vector(m);
   prod_matrix_matrix(m);
+  prod_matrix_dense(m);
 
   m.compress();
 
   prod_matrix_vector(m);
   prod_matrix_matrix(m);
+  prod_matrix_dense(m);
+
+  reorder_test(m);
 
   //norm_test(m);
 
+  if (laplace)
+    laplace_test(130);
+
 
   return 0;
 }
@@ -2,37 +2,79 @@
 
 #include "mesh_data_class.hpp"
 #include <optional>
+#include <array>
+#include <algorithm>
 
-class Mesh : public mesh_data_class{
+template<typename T>
+class Mesh : public mesh_data_class<T>{
     /**
      * @brief Extension of the mesh_data_class to handle mesh update
+     * @note the updates are computed in T, the squared differences of the error are accumulated in double
     */
 
     protected:
+    using mesh_data_class<T>::mesh;
+    using mesh_data_class<T>::mesh_old;
+    using mesh_data_class<T>::n_row;
+    using mesh_data_class<T>::n_col;
+    using mesh_data_class<T>::h;
+    using mesh_data_class<T>::domain;
+    using mesh_data_class<T>::offset;
+    using mesh_data_class<T>::col_offset;
+    using mesh_data_class<T>::p;
+    using mesh_data_class<T>::f_str;
+    using mesh_data_class<T>::error;
+
     // vector of f evaluations to avoid re-calculation
-    std::vector<double> f_eval;
+    aligned_vector<T> f_eval;
+
+    // rows and columns of the tiles of the tiled kernel
+    size_t tile_rows = 16;
+    size_t tile_cols = 1024;
+
+    // threads, tile rows and tile columns of the team which placed the pages of the meshes, see first_touch
+    std::array<size_t, 3> placement = {0, 0, 0};
 
-    void f_eval_creation();
+    void f_eval_creation(const int & n_tasks = 4);
 
     std::optional<std::string> parser_creation(const std::string & f);
     bool check(const size_t & i, const size_t & j) const;
-    double f(double x, double y, mu::Parser parser);
+    static void evaluate(mu::Parser & parser, std::vector<double> & x, std::vector<double> & y, double * results);
+
+    double update_block(const size_t & r_begin, const size_t & r_end, const size_t & c_begin, const size_t & c_end, const int & n_tasks = 4, const bool & residual = false);
+    static double sweep_row(const T * __restrict src, T * __restrict dst, const T * __restrict f, const size_t & r, const size_t & n_col,
+                            const size_t & c_begin, const size_t & c_end, const T & hh, const bool & residual);
+    double update_block_tiled(const size_t & r_begin, const size_t & r_end, const size_t & c_begin, const size_t & c_end, const int & n_tasks = 4, const bool & residual = false);
+    double update_block_team(const size_t & r_begin, const size_t & r_end, const size_t & c_begin, const size_t & c_end, const bool & tiled, const bool & residual);
+    double update_color_row(const size_t & r, const int & color, const T & omega, const T & hh, const bool & residual);
+    double update_color(const int & color, const double & omega, const int & n_tasks = 4, const bool & residual = false);
+    double update_color_team(const int & color, const double & omega, const bool & residual);
+    void first_touch(const int & n_tasks, const bool & tiled);
 
     public:
+    using mesh_data_class<T>::get_coordinates;
+
     Mesh(const size_t & row_number, const size_t & col_number, const Domain & domain_, const std::string & f);
-    Mesh(const std::vector<double> & _mesh, const size_t & col_number, const Domain & domain_, const std::string & f); 
+    Mesh(const std::vector<T> & _mesh, const size_t & col_number, const Domain & domain_, const std::string & f);
 
     // Updaters
     void update_seq();
-    void update_par(const int & n_tasks = 4);
+    void update_par(const int & n_tasks = 4, const bool & residual = true);
+    void update_tiled(const int & n_tasks = 4, const bool & residual = true);
+    void update_wavefront(const int & steps, const int & n_tasks = 4, const bool & residual = true);
+    void update_red_black(const double & omega = 1, const int & n_tasks = 4, const bool & residual = true);
+    void update_device(const bool & residual = true);
     void update_error();
+    void residual(aligned_vector<T> & r, const int & n_tasks = 4) const;
 
     // Getters
     double get_error() const { return error; }
+    double optimal_omega() const;
     std::string get_f() const { return f_str; }
 
     // Setters
-    void set_boundary(const size_t & idx, const std::vector<double> & value, const bool & isColumn);
-    std::optional<std::string> add_boundary_condition(const std::string & f);
-    void set_f_eval(const std::vector<double> & f) { f_eval = f; }
+    void set_boundary(const size_t & idx, const std::vector<T> & value, const bool & isColumn);
+    std::optional<std::string> add_boundary_condition(const std::string & f, const std::array<bool, 4> & sides = {true, true, true, true});
+    void set_tiles(const size_t & rows, const size_t & cols) { tile_rows = std::max<size_t>(rows, 1); tile_cols = std::max<size_t>(cols, 1); }
+    void set_f_eval(const aligned_vector<T> & f) { f_eval = f; }
 };
\ No newline at end of file
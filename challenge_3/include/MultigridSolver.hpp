@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Solver.hpp"
+#include <memory>
+
+template<typename T>
+class MultigridSolver : public Solver<T>{
+  /**
+   * @brief Class to solve the PDE with geometric multigrid V-cycles
+   * @note the finest level is the (distributed) mesh of the Solver, the coarser levels are distributed in the same way until they have
+   * gather_points points of each side, then they are stored and solved by rank 0
+   */
+
+  using mesh_data_class<T>::mesh;
+  using mesh_data_class<T>::mesh_old;
+  using mesh_data_class<T>::n_row;
+  using mesh_data_class<T>::n_col;
+  using mesh_data_class<T>::h;
+  using mesh_data_class<T>::domain;
+  using mesh_data_class<T>::rank;
+  using mesh_data_class<T>::size;
+  using mesh_data_class<T>::offset;
+  using mesh_data_class<T>::col_offset;
+  using mesh_data_class<T>::f_str;
+  using mesh_data_class<T>::error;
+  using mesh_data_class<T>::scalar_type;
+  using Mesh<T>::f_eval_creation;
+  using Solver<T>::n_points;
+  using Solver<T>::cond;
+  using Solver<T>::first_iter;
+  using Solver<T>::times;
+  using Solver<T>::update_red_black_mpi;
+  using Solver<T>::communicate_boundary;
+  using Solver<T>::periodic_output;
+  using Solver<T>::finish_checkpoint;
+  using Solver<T>::print_exact_distance;
+  using Solver<T>::write_output;
+  using Solver<T>::run;
+  using Solver<T>::report;
+
+  // coarse levels with more points of each side are distributed on the blocks of the processes, the smaller ones are solved by rank 0
+  static constexpr size_t gather_points = 129;
+
+  // points of each side of the coarse levels (on every process), first the distributed ones, then the ones stored by rank 0
+  std::vector<size_t> level_points;
+  std::vector<std::unique_ptr<Solver<T>>> blocks;
+  std::vector<Mesh<T>> levels;
+
+  // residual of the finest level and of each coarse level, restricted residual of each level of rank 0 (the first one on every
+  // process), allocated once by build_levels
+  std::vector<aligned_vector<T>> residuals;
+  std::vector<aligned_vector<T>> restricted;
+
+  static double scale(const size_t & n_fine, const size_t & n_coarse) { return (n_coarse - 1.0)/(n_fine - 1.0); }
+  static void restriction(const aligned_vector<T> & fine, const size_t & rows, const size_t & cols, const int & row_off, const int & col_off,
+                          const size_t & n_fine, aligned_vector<T> & coarse, const size_t & c_rows, const size_t & c_cols, const int & c_row_off,
+                          const int & c_col_off, const size_t & n_coarse, const int & n_tasks);
+  static void prolongation(const aligned_vector<T> & coarse, const size_t & c_cols, const int & c_row_off, const int & c_col_off,
+                           const size_t & n_coarse, aligned_vector<T> & fine, const size_t & rows, const size_t & cols, const int & row_off,
+                           const int & col_off, const size_t & n_fine, const int & n_tasks);
+
+  void build_levels();
+  void v_cycle(const size_t & level, const conditions & c, const int & n_tasks);
+  void correction(Solver<T> & fine, const size_t & level, const conditions & c, const int & n_tasks);
+  void cycle(const conditions & c, const int & n_tasks);
+  int iterate(const int & thread) override;
+  // a V-cycle sweeps every level, so it is not counted as a lattice update of the mesh
+  bool counts_updates() const override { return false; }
+
+  public:
+  using Solver<T>::get_error;
+  using Solver<T>::residual;
+  using Solver<T>::final_communication;
+
+  MultigridSolver(std::vector<T> & _mesh, const Domain & d, const size_t & n_col, const std::string & f);
+  MultigridSolver(const size_t & n, const Domain & d, const std::string & f);
+  MultigridSolver(Mesh<T> & m);
+
+  std::optional<std::vector<T>> solution_finder_sequential(const int & thread = 4);
+  void solution_finder_mpi(std::vector<T> & final_mesh, const int & thread = 4);
+};
@@ -2,23 +2,168 @@
 
 #include "Mesh.hpp"
 #include "parameters.hpp"
+#include <array>
+#include <cstdint>
 
-class Solver : public Mesh{
+template<typename T>
+class Solver : public Mesh<T>{
   /**
    * @brief Class to handle the solver of the PDE
+   * @note T is the type of the values of the mesh, the ghost cells are exchanged in T too
    */
 
+  // the mixed precision solver runs its first iterations on a copy in float
+  template<typename> friend class Solver;
+  // multigrid smooths its distributed coarse levels as solvers on the same processes
+  template<typename> friend class MultigridSolver;
+
+  protected:
+  using mesh_data_class<T>::mesh;
+  using mesh_data_class<T>::mesh_old;
+  using mesh_data_class<T>::n_row;
+  using mesh_data_class<T>::n_col;
+  using mesh_data_class<T>::h;
+  using mesh_data_class<T>::domain;
+  using mesh_data_class<T>::rank;
+  using mesh_data_class<T>::size;
+  using mesh_data_class<T>::offset;
+  using mesh_data_class<T>::col_offset;
+  using mesh_data_class<T>::f_str;
+  using mesh_data_class<T>::error;
+  using mesh_data_class<T>::scalar_type;
+  using mesh_data_class<T>::vtk_type;
+  using mesh_data_class<T>::image_attributes;
+  using Mesh<T>::f_eval;
+  using Mesh<T>::tile_rows;
+  using Mesh<T>::tile_cols;
+  using Mesh<T>::f_eval_creation;
+  using Mesh<T>::update_block;
+  using Mesh<T>::update_block_tiled;
+  using Mesh<T>::update_block_team;
+  using Mesh<T>::update_color;
+  using Mesh<T>::update_color_team;
+  using Mesh<T>::first_touch;
+
   // variables for MPI to avoid re-calculation
   std::vector<int> send_counts;
 
+  // pending requests of the non-blocking exchange of the ghost cells
+  std::array<MPI_Request, 8> requests;
+  int n_requests = 0;
+
+  // Cartesian decomposition: grid of processes, neighbours (up, down, left, right) and datatype of a column of ghost cells
+  MPI_Comm cart_comm = MPI_COMM_NULL;
+  std::array<int, 2> dims = {0, 0};
+  std::array<int, 4> neighbours = {MPI_PROC_NULL, MPI_PROC_NULL, MPI_PROC_NULL, MPI_PROC_NULL};
+  MPI_Datatype column_type = MPI_DATATYPE_NULL;
+
+  // ghost cells received by accumulate_boundary
+  std::vector<T> ghost_sums;
+
+  // points of each side of the whole mesh
+  size_t n_points = 0;
+
+  // parameters of the solver
+  conditions cond;
+
+  // checkpoint written in background, its file stays open until the write is completed
+  struct checkpoint_header {
+    char magic[8];
+    std::uint64_t n_points;
+    std::int64_t iteration;
+    double error;
+  };
+  MPI_File checkpoint_file = MPI_FILE_NULL;
+  MPI_Request checkpoint_request = MPI_REQUEST_NULL;
+  std::vector<double> checkpoint_buffer;
+
+  // first iteration, not 0 after a restart
+  int first_iter = 0;
+
+  // time spent by this process in each phase, in seconds: the residual is fused in the sweeps, so residual is the time of the sweeps
+  // which compute it (all of them with check_every 1, and the V-cycles) and kernel the time of the other ones
+  struct timings {
+    double wall = 0, setup = 0, kernel = 0, residual = 0, halo = 0, allreduce = 0, output = 0;
+    int iterations = 0;
+  };
+  timings times;
+  std::vector<timings> trial_times;
+
+  static std::vector<int> distribute(const int & points, const int & parts);
+  static std::array<int, 2> cartesian_dims(const int & n_process);
+  static size_t cartesian_points(const size_t & n, const int & dim);
+  static std::array<int, 2> coarse_block(const int & offset, const size_t & points, const size_t & n_fine, const size_t & n_coarse);
+
+  bool is_cartesian() const { return cart_comm != MPI_COMM_NULL; }
+  // an iteration is a sweep of the interior points, so the report counts lattice updates
+  virtual bool counts_updates() const { return true; }
+  // bytes of each value read or written by the sweeps, the mixed precision solver sweeps in float
+  size_t sweep_bytes() const { return std::is_same_v<T, double> && cond.precision == 2 ? sizeof(float) : sizeof(T); }
+  std::array<int, 4> cartesian_block(const int & process) const;
+
+  void start_communication_boundary(T * m);
+  void communicate_boundary_device(T * edges);
+  void accumulate_boundary(aligned_vector<T> & v);
+  double jacobi_block(const size_t & r_begin, const size_t & r_end, const size_t & c_begin, const size_t & c_end, const int & n_tasks, const bool & residual);
+  void jacobi(const int & n_tasks = 4, const bool & residual = true);
+  void update_par_overlap(const int & n_tasks = 4, const bool & residual = true);
+  void update_red_black_mpi(const double & omega, const int & n_tasks = 4, const bool & residual = true);
+  double relaxation(const conditions & c) const;
+  int iterate_team(const int & n_tasks);
+  virtual int iterate(const int & thread);
+  int iterate_loop(const int & thread);
+  int iterate_mixed(const int & thread);
+  int iterate_device(const int & thread);
+  int run(const int & thread);
+  void report(const int & thread) const;
+
+  std::vector<int> slab_layout();
+  std::array<bool, 4> physical_sides() const;
+  std::array<size_t, 4> owned_block() const;
+  void print_exact_distance() const;
+
+  std::string output_name() const;
+  void write_output() const;
+  void write_pieces(const std::string & name);
+
+  void start_checkpoint(const int & iter);
+  void finish_checkpoint();
+  void periodic_output(const int & from, const int & to);
+
+  void initial_communication_cartesian(std::vector<T> & initial_mesh);
+  void final_communication_slabs(std::vector<T> & final_mesh);
+  void final_communication_cartesian(std::vector<T> & final_mesh);
+
   public:
-  Solver(std::vector<double> & _mesh, const Domain & d, const size_t & n_col, const std::string & f);
-  Solver(Mesh & m);
+  using mesh_data_class<T>::write;
+  using mesh_data_class<T>::write_vti;
+  using mesh_data_class<T>::get_coordinates;
+  using Mesh<T>::get_error;
+  using Mesh<T>::set_tiles;
+  using Mesh<T>::update_par;
+  using Mesh<T>::update_tiled;
+  using Mesh<T>::update_wavefront;
+  using Mesh<T>::add_boundary_condition;
+  using Mesh<T>::optimal_omega;
+  using Mesh<T>::residual;
+
+  Solver(std::vector<T> & _mesh, const Domain & d, const size_t & n_col, const std::string & f);
+  Solver(const size_t & n, const Domain & d, const std::string & f);
+  Solver(Mesh<T> & m);
+  Solver(const Solver & fine, const size_t & n);
+  template<typename U>
+  explicit Solver(const Solver<U> & other);
+  Solver(const Solver &) = delete;
+  Solver & operator=(const Solver &) = delete;
+  virtual ~Solver();
 
+  void set_conditions(const conditions & c) { cond = c; }
   void print_mesh() const;
-  std::optional<std::vector<double>> solution_finder_sequential();
-  void initial_communication(std::vector<double> & initial_mesh);
-  void solution_finder_mpi(std::vector<double> & final_mesh, const int & thread = 4);
+  std::optional<std::vector<T>> solution_finder_sequential(const int & thread = 4);
+  void initial_communication(std::vector<T> & initial_mesh);
+  void initial_condition(const std::string & boundary);
+  void solution_finder_mpi(std::vector<T> & final_mesh, const int & thread = 4);
   void communicate_boundary();
-  void final_communication(std::vector<double> & final_mesh);
-};
\ No newline at end of file
+  void restart();
+  void final_communication(std::vector<T> & final_mesh);
+};
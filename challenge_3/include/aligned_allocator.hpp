@@ -0,0 +1,47 @@
+#pragma once
+
+#include<cstddef>
+#include<new>
+#include<utility>
+#include<vector>
+
+template<typename T, std::size_t Alignment = 64>
+struct aligned_allocator {
+  /**
+   * @brief Allocator that aligns the storage to Alignment bytes (a cache line by default), used for the meshes
+   * so that the vectorized stencil starts every sweep on an aligned address
+  */
+
+  typedef T value_type;
+
+  template<typename U>
+  struct rebind { typedef aligned_allocator<U, Alignment> other; };
+
+  aligned_allocator() noexcept = default;
+  template<typename U>
+  aligned_allocator(const aligned_allocator<U, Alignment> &) noexcept {}
+
+  T * allocate(const std::size_t n) {
+    return static_cast<T *>(::operator new(n*sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T * p, const std::size_t) noexcept {
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+
+  // elements created without a value are default-initialised, so the pages of a new vector of double are not written
+  // until each thread touches its own part of it
+  template<typename U>
+  void construct(U * p) noexcept { ::new(static_cast<void *>(p)) U; }
+  template<typename U, typename... Args>
+  void construct(U * p, Args &&... args) { ::new(static_cast<void *>(p)) U(std::forward<Args>(args)...); }
+
+  template<typename U>
+  bool operator==(const aligned_allocator<U, Alignment> &) const noexcept { return true; }
+  template<typename U>
+  bool operator!=(const aligned_allocator<U, Alignment> &) const noexcept { return false; }
+};
+
+// vector used to store the values of a mesh
+template<typename T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
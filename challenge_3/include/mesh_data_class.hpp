@@ -10,22 +10,28 @@
 #include<muParser.h>
 #include<omp.h>
 #include<mpi.h>
+#include<type_traits>
+#include "aligned_allocator.hpp"
 
 struct Domain {
     double x0, x1, y0, y1;
     Domain(double _x0, double _x1, double _y0, double _y1) : x0(_x0), x1(_x1), y0(_y0), y1(_y1) {};
 };
 
+template<typename T>
 class mesh_data_class {
     /**
      * @brief Base class to handle the mesh data
+     * @note T is the type of the values of the mesh (float or double), coordinates and errors are always double
     */
 
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "The mesh stores float or double values");
+
     protected:
 
     int spacing = 10;
-    std::vector<double> mesh;
-    std::vector<double> mesh_old;
+    aligned_vector<T> mesh;
+    aligned_vector<T> mesh_old;
     size_t n_row, n_col;
     double h;
     Domain domain;
@@ -36,6 +42,7 @@ class mesh_data_class {
 
     // offset to corrected coordinates
     mutable int offset = 0;
+    mutable int col_offset = 0;
 
     // muParser variables
     mu::Parser p;
@@ -43,26 +50,36 @@ class mesh_data_class {
 
     // error
     double error = 0;
+
+    std::string image_attributes(const size_t & whole_rows, const size_t & whole_cols) const;
+    std::string extent(const size_t & rows, const size_t & cols) const;
+
+    // MPI datatype of the values of the mesh
+    static MPI_Datatype scalar_type() { return std::is_same_v<T, float> ? MPI_FLOAT : MPI_DOUBLE; }
+    // VTK type of the values of the mesh
+    static const char * vtk_type() { return std::is_same_v<T, float> ? "Float32" : "Float64"; }
     
     public:
     mesh_data_class(const size_t & row_number, const size_t & col_number, const Domain & domain_);
-    mesh_data_class(const std::vector<double> & _mesh, const size_t & col_number, const Domain & domain_);
+    mesh_data_class(const std::vector<T> & _mesh, const size_t & col_number, const Domain & domain_);
 
     void print() const;
 
     std::optional<std::string> write(const std::string & filename) const;
+    std::optional<std::string> write_vti(const std::string & filename, const size_t & rows, const size_t & cols, const size_t & whole_rows, const size_t & whole_cols) const;
 
     // Getters
-    std::vector<double> & get_mesh() { return mesh; }
-    std::vector<double> get_mesh_old() const { return mesh_old; }
+    aligned_vector<T> & get_mesh() { return mesh; }
+    aligned_vector<T> get_mesh_old() const { return mesh_old; }
     std::pair<size_t, size_t> get_size() const { return std::make_pair(n_row, n_col); }
     double get_h() const { return h; }
     Domain get_domain() const { return domain; }
     std::pair<double, double> get_coordinates(const size_t & r, const size_t & c) const;
-    double get_value(const size_t & r, const size_t & c) const {return mesh[r*n_col + c];};
+    T get_value(const size_t & r, const size_t & c) const {return mesh[r*n_col + c];};
 
     // Setters
-    std::optional<std::string> set_mesh(const std::vector<double> & _mesh);
-    std::optional<std::string> set_mesh_old(const std::vector<double> & _mesh);
+    std::optional<std::string> set_mesh(const std::vector<T> & _mesh);
+    std::optional<std::string> set_mesh_old(const std::vector<T> & _mesh);
     void set_offset(const int & _offset) { offset = _offset; }
+    void set_col_offset(const int & _offset) { col_offset = _offset; }
 };
\ No newline at end of file
@@ -2,11 +2,95 @@
 
 #include<functional>
 #include<cmath>
+#include<string>
 
 struct conditions{
   double tolerance = 1e-7;
   int n_max = 1e5;
 
+  // the error is computed (and reduced among MPI processes) only every check_every iterations
+  int check_every = 1;
+
+  /*
+  Method to update the mesh:
+  0 - Jacobi
+  1 - red-black Gauss-Seidel
+  2 - red-black SOR
+  3 - multigrid V-cycles with red-black Gauss-Seidel as smoother
+  */
+  int method = 0;
+
+  // multigrid only: smoothing sweeps before and after the coarse correction
+  int pre_smoothing = 2;
+  int post_smoothing = 2;
+
+  // relaxation factor of SOR, if it is not inside (0, 2) the optimal one for the Laplace problem is estimated
+  double omega = 0;
+
+  /*
+  Precision of the values of the mesh:
+  0 - double
+  1 - float
+  2 - mixed: float sweeps on the correction of a double solution, refined in double every refine_every iterations (Jacobi and red-black methods)
+  */
+  int precision = 0;
+  int refine_every = 100;
+
+  /*
+  Kernel of the Jacobi sweep:
+  0 - row by row
+  1 - tiles of tile_rows x tile_cols points with a vectorized inner loop
+  */
+  int kernel = 0;
+  int tile_rows = 16;
+  int tile_cols = 1024;
+
+  // tiled kernel without MPI only: Jacobi sweeps done in a single pass over the mesh with a wavefront
+  int time_steps = 1;
+
+  // run all the iterations inside a single parallel region with one team of threads bound to the cores (Jacobi and red-black methods)
+  bool persistent = false;
+
+  // Jacobi only: run the sweeps on the default OpenMP device (GPU, build with make offload), the meshes stay on it until the end
+  bool device = false;
+
+  // MPI only: overlap the exchange of the ghost cells with the update of the interior points (Jacobi only)
+  bool overlap = false;
+
+  // MPI only: each process builds its own block with the boundary conditions, instead of receiving it from the whole mesh on rank 0
+  bool distributed_setup = false;
+
+  /*
+  MPI only: decomposition of the mesh among processes
+  1 - slabs of rows
+  2 - 2D Cartesian blocks
+  */
+  int decomposition = 1;
+
+  /*
+  Output of the solution inside vtk_files:
+  0 - none
+  1 - legacy ASCII VTK written by rank 0 after gathering the whole mesh
+  2 - binary VTK XML image, each process writes its own piece (.vti) without gathering and rank 0 the list of the pieces (.pvti)
+  */
+  int output = 1;
+
+  // checkpoint of the mesh with iteration and error, written in background with MPI-IO every checkpoint_every iterations (0 never)
+  int checkpoint_every = 0;
+  std::string checkpoint = "vtk_files/checkpoint.bin";
+
+  // start from the checkpoint instead of the initial mesh
+  bool restart = false;
+
+  // binary VTK pieces of the current mesh (as output 2) every snapshot_every iterations (0 never)
+  int snapshot_every = 0;
+
+  // iterations repeated trials times from the same initial mesh, the statistics of the times are printed when there is more than one
+  int trials = 1;
+
+  // CSV file where the timings of each trial and process are appended (empty for none), see tests/benchmark.sh
+  std::string benchmark = "";
+
   // Distance from the exact solution for the test function 4*pi^2*cos(2*pi*x)*cos(2*pi*y) and as boundary condition 0
   // the correct solution is sin(2*pi*x)*sin(2*pi*y)
   std::function<double(double, double)> u = [](double x, double y){return sin(2*M_PI*x)*sin(2*M_PI*y);};
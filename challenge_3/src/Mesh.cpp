@@ -1,42 +1,58 @@
 #include "Mesh.hpp"
 #include <muParser.h>
+#include <tuple>
 
-double Mesh::f(double x, double y, mu::Parser parser){
+template<typename T>
+void Mesh<T>::evaluate(mu::Parser & parser, std::vector<double> & x, std::vector<double> & y, double * results){
   /**
-   * @brief Function to evaluate the function f
-   * @param x is the x coordinate
-   * @param y is the y coordinate
-   * @param parser is the muparser parser
-   * @return the value of the function f at x and y
+   * @brief Function to evaluate a parsed function on many points with a single bulk evaluation of muParser
+   * @param parser is the muparser parser, its variables are bound to x and y
+   * @param x are the x coordinates of the points
+   * @param y are the y coordinates of the points
+   * @param results is where the x.size() values are written
   */
 
-  parser.DefineVar("x", &x);
-  parser.DefineVar("y", &y);
-  return parser.Eval();
+  if(x.empty())
+    return;
+
+  parser.DefineVar("x", x.data());
+  parser.DefineVar("y", y.data());
+  parser.Eval(results, static_cast<int>(x.size()));
 }
 
-void Mesh::f_eval_creation(){
+template<typename T>
+void Mesh<T>::f_eval_creation(const int & n_tasks){
   /**
    * @brief Function to create the f_eval vector
+   * @note each thread evaluates its rows with its own copy of the parser, one bulk evaluation per row
+   * @param n_tasks is the number of parallel tasks
   */
 
   // Create evaluation of f
-  f_eval.resize(n_row * n_col, 0);
-  std::pair<double, double> coords;
-  p.DefineVar("x", &coords.first);
-  p.DefineVar("y", &coords.second);
-
-  for(size_t r = 1; r < n_row - 1; ++r) {
-    for(size_t c = 1; c < n_col - 1; ++c) {
-      // calculate + update value in the mesh
-      coords = get_coordinates(r, c);
-      f_eval[r*n_col + c] = p.Eval();
+  f_eval.assign(n_row * n_col, 0);
+  if(n_row < 3 || n_col < 3)
+    return;
+
+  #pragma omp parallel num_threads(n_tasks)
+  {
+    // a parser can't be shared among threads, since its variables point to the arrays of the thread
+    mu::Parser parser(p);
+    std::vector<double> x(n_col - 2), y(n_col - 2), values(n_col - 2);
+
+    #pragma omp for schedule(static)
+    for(size_t r = 1; r < n_row - 1; ++r) {
+      for(size_t c = 1; c < n_col - 1; ++c)
+        std::tie(x[c - 1], y[c - 1]) = get_coordinates(r, c);
+
+      // muParser evaluates in double
+      evaluate(parser, x, y, values.data());
+      std::copy(values.begin(), values.end(), f_eval.begin() + r*n_col + 1);
     }
   }
-
 }
 
-std::optional<std::string> Mesh::parser_creation(const std::string & f){
+template<typename T>
+std::optional<std::string> Mesh<T>::parser_creation(const std::string & f){
   /**
    * @brief Function to create the parser
    * @param f is the function to parse
@@ -56,7 +72,8 @@ std::optional<std::string> Mesh::parser_creation(const std::string & f){
   return std::nullopt;
 }
 
-bool Mesh::check(const size_t & i, const size_t & j) const {
+template<typename T>
+bool Mesh<T>::check(const size_t & i, const size_t & j) const {
     /**
      * @brief Function to check if indexes are inside the matrix 
      * @param i row index
@@ -67,7 +84,8 @@ bool Mesh::check(const size_t & i, const size_t & j) const {
     return i < n_row && j < n_col;
 }
 
-Mesh::Mesh(const size_t & row_number, const size_t & col_number, const Domain & domain_, const std::string & f) : mesh_data_class(row_number, col_number, domain_) {
+template<typename T>
+Mesh<T>::Mesh(const size_t & row_number, const size_t & col_number, const Domain & domain_, const std::string & f) : mesh_data_class<T>(row_number, col_number, domain_) {
   /**
    * @brief Constructor of the Mesh class
    * @param row_number is the number of rows of the mesh
@@ -84,12 +102,10 @@ Mesh::Mesh(const size_t & row_number, const size_t & col_number, const Domain &
 
   // set values of the f_eval
   f_eval.resize(n_row*n_col, 0);
-  std::pair<double, double> coords;
-  p.DefineVar("x", &coords.first);
-  p.DefineVar("y", &coords.second);
 }
 
-Mesh::Mesh(const std::vector<double> & _mesh, const size_t & col_number, const Domain & domain_, const std::string & f): mesh_data_class(_mesh, col_number, domain_){
+template<typename T>
+Mesh<T>::Mesh(const std::vector<T> & _mesh, const size_t & col_number, const Domain & domain_, const std::string & f): mesh_data_class<T>(_mesh, col_number, domain_){
   /**
    * @brief Constructor of the Mesh class
    * @param _mesh is the mesh vector
@@ -106,7 +122,8 @@ Mesh::Mesh(const std::vector<double> & _mesh, const size_t & col_number, const D
   }
 }
 
-void Mesh::update_seq(){
+template<typename T>
+void Mesh<T>::update_seq(){
   /**
    * @brief Function to update the mesh using the Jacobi method sequentially
   */
@@ -115,55 +132,523 @@ void Mesh::update_seq(){
   std::swap(mesh, mesh_old);
 
   // Precompute constant values outside the loop
-  const double hh = h * h;
+  const T hh = h * h;
+
+  // squared difference with the previous iteration, computed while updating
+  double sum = 0;
 
   for(size_t r = 1; r < n_row - 1; ++r) {
     for(size_t c = 1; c < n_col - 1; ++c) {
-      mesh[r*n_col + c] = 0.25*(mesh_old[(r-1)*n_col + c] + mesh_old[(r+1)*n_col + c] + mesh_old[r*n_col + (c-1)] + mesh_old[r*n_col + (c+1)] + hh*f_eval[r*n_col + c]);
+      mesh[r*n_col + c] = T(0.25)*(mesh_old[(r-1)*n_col + c] + mesh_old[(r+1)*n_col + c] + mesh_old[r*n_col + (c-1)] + mesh_old[r*n_col + (c+1)] + hh*f_eval[r*n_col + c]);
+      sum += (mesh[r*n_col + c] - mesh_old[r*n_col + c])*(mesh[r*n_col + c] - mesh_old[r*n_col + c]);
+    }
+  }
+
+  error = std::sqrt(h*sum);
+}
+
+template<typename T>
+double Mesh<T>::update_block(const size_t & r_begin, const size_t & r_end, const size_t & c_begin, const size_t & c_end, const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to update a block of the mesh using the Jacobi method - openMP parallel version
+   * @note it reads from mesh_old and writes into mesh, the swap of the meshes is up to the caller
+   * @param r_begin is the first row to update
+   * @param r_end is the row after the last one to update
+   * @param c_begin is the first column to update
+   * @param c_end is the column after the last one to update
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to compute also the squared difference with mesh_old in the same loop
+   * @return sum of the squared differences of the block with mesh_old, 0 if residual is false
+  */
+
+  // Precompute constant values outside the loop
+  const T hh = h * h;
+
+  auto stencil = [&](const size_t & r, const size_t & c){
+    return T(0.25)*(mesh_old[(r-1)*n_col + c] + mesh_old[(r+1)*n_col + c] + mesh_old[r*n_col + (c-1)] + mesh_old[r*n_col + (c+1)] + hh*f_eval[r*n_col + c]);
+  };
+
+  double sum = 0;
+
+  if(residual){
+    #pragma omp parallel for num_threads(n_tasks) reduction(+:sum)
+    for(size_t r = r_begin; r < r_end; ++r) {
+      for(size_t c = c_begin; c < c_end; ++c) {
+        const T value = stencil(r, c);
+        sum += (value - mesh_old[r*n_col + c])*(value - mesh_old[r*n_col + c]);
+        mesh[r*n_col + c] = value;
+      }
+    }
+  }
+  else{
+    #pragma omp parallel for num_threads(n_tasks)
+    for(size_t r = r_begin; r < r_end; ++r) {
+      for(size_t c = c_begin; c < c_end; ++c) {
+        mesh[r*n_col + c] = stencil(r, c);
+      }
     }
   }
 
-  update_error();
+  return sum;
 }
 
-void Mesh::update_par(const int & n_tasks) {
+template<typename T>
+void Mesh<T>::update_par(const int & n_tasks, const bool & residual) {
   /**
    * @brief Function to update the mesh using the Jacobi method - openMP parallel version
+   * @note the error is updated in the same sweep, if it is not asked the previous error is kept
    * @param n_tasks is the number of parallel tasks
+   * @param residual is true to update also the error
   */
   
   // swap the meshes, in this way the useless value are overwrite
   std::swap(mesh, mesh_old);
 
+  const double sum = update_block(1, n_row - 1, 1, n_col - 1, n_tasks, residual);
+
+  if(residual)
+    error = std::sqrt(h*sum);
+}
+
+template<typename T>
+void Mesh<T>::update_device(const bool & residual) {
+  /**
+   * @brief Function to update the mesh using the Jacobi method on the default OpenMP device
+   * @note mesh, mesh_old and f_eval have to be already mapped on the device (target data), only the error comes back to the host.
+   * Without a device the loop runs on the host
+   * @param residual is true to update also the error
+  */
+
+  // swap the meshes, the mapping follows the buffers
+  std::swap(mesh, mesh_old);
+
+  // members are not mapped, so the loop works on local copies
+  const T hh = h * h;
+  const T * src = mesh_old.data();
+  T * dst = mesh.data();
+  const T * f = f_eval.data();
+  const size_t rows = n_row, cols = n_col;
+
+  double sum = 0;
+
+  if(residual){
+    #pragma omp target teams distribute parallel for collapse(2) reduction(+:sum) map(tofrom: sum)
+    for(size_t r = 1; r < rows - 1; ++r) {
+      for(size_t c = 1; c < cols - 1; ++c) {
+        const size_t i = r*cols + c;
+        const T value = T(0.25)*(src[i - cols] + src[i + cols] + src[i - 1] + src[i + 1] + hh*f[i]);
+        sum += (value - src[i])*(value - src[i]);
+        dst[i] = value;
+      }
+    }
+
+    error = std::sqrt(h*sum);
+  }
+  else{
+    #pragma omp target teams distribute parallel for collapse(2)
+    for(size_t r = 1; r < rows - 1; ++r) {
+      for(size_t c = 1; c < cols - 1; ++c) {
+        const size_t i = r*cols + c;
+        dst[i] = T(0.25)*(src[i - cols] + src[i + cols] + src[i - 1] + src[i + 1] + hh*f[i]);
+      }
+    }
+  }
+}
+
+template<typename T>
+double Mesh<T>::sweep_row(const T * __restrict src, T * __restrict dst, const T * __restrict f, const size_t & r, const size_t & n_col,
+                       const size_t & c_begin, const size_t & c_end, const T & hh, const bool & residual) {
+  /**
+   * @brief Function to update a segment of a row with the Jacobi method, the inner loop is vectorized
+   * @note src and dst are different buffers, so the compiler can keep the loads of the three rows in vector registers
+   * @param src is the mesh of the previous iteration
+   * @param dst is the mesh where the new values are written
+   * @param f is the evaluation of f on the mesh
+   * @param r is the row to update
+   * @param n_col is the number of columns of the mesh
+   * @param c_begin is the first column to update
+   * @param c_end is the column after the last one to update
+   * @param hh is the square of the step of the mesh
+   * @param residual is true to compute also the squared difference with src
+   * @return sum of the squared differences of the segment with src, 0 if residual is false
+  */
+
+  const T * __restrict up = src + (r - 1)*n_col;
+  const T * __restrict mid = src + r*n_col;
+  const T * __restrict down = src + (r + 1)*n_col;
+  const T * __restrict fr = f + r*n_col;
+  T * __restrict out = dst + r*n_col;
+
+  double sum = 0;
+
+  if(residual){
+    #pragma omp simd reduction(+:sum)
+    for(size_t c = c_begin; c < c_end; ++c){
+      const T value = T(0.25)*(up[c] + down[c] + mid[c - 1] + mid[c + 1] + hh*fr[c]);
+      sum += (value - mid[c])*(value - mid[c]);
+      out[c] = value;
+    }
+  }
+  else{
+    #pragma omp simd
+    for(size_t c = c_begin; c < c_end; ++c)
+      out[c] = T(0.25)*(up[c] + down[c] + mid[c - 1] + mid[c + 1] + hh*fr[c]);
+  }
+
+  return sum;
+}
+
+template<typename T>
+double Mesh<T>::update_block_team(const size_t & r_begin, const size_t & r_end, const size_t & c_begin, const size_t & c_end, const bool & tiled, const bool & residual) {
+  /**
+   * @brief Function to update a block of the mesh using the Jacobi method, shared among the threads of the enclosing parallel region
+   * @note it has to be called by all the threads of the team, the rows (or the tiles) are split with an orphaned omp for
+   * without barrier at the end, so the caller has to synchronize the threads before using the result
+   * @param r_begin is the first row to update
+   * @param r_end is the row after the last one to update
+   * @param c_begin is the first column to update
+   * @param c_end is the column after the last one to update
+   * @param tiled is true to use tiles of tile_rows x tile_cols points, false to update whole rows
+   * @param residual is true to compute also the squared difference with mesh_old in the same loop
+   * @return sum of the squared differences of the points updated by the calling thread, 0 if residual is false
+  */
+
+  if(r_begin >= r_end || c_begin >= c_end)
+    return 0;
+
   // Precompute constant values outside the loop
-  const double hh = h * h;
+  const T hh = h * h;
+  const size_t t_rows = tiled ? tile_rows : 1;
+  const size_t t_cols = tiled ? tile_cols : c_end - c_begin;
+  const size_t tiles_r = (r_end - r_begin + t_rows - 1)/t_rows;
+  const size_t tiles_c = (c_end - c_begin + t_cols - 1)/t_cols;
 
-  #pragma omp parallel for num_threads(n_tasks)
-  for(size_t r = 1; r < n_row - 1; ++r) {
-    for(size_t c = 1; c < n_col - 1; ++c) {
-      mesh[r*n_col + c] = 0.25*(mesh_old[(r-1)*n_col + c] + mesh_old[(r+1)*n_col + c] + mesh_old[r*n_col + (c-1)] + mesh_old[r*n_col + (c+1)] + hh*f_eval[r*n_col + c]);
+  const T * src = mesh_old.data();
+  T * dst = mesh.data();
+
+  double sum = 0;
+
+  #pragma omp for collapse(2) schedule(static) nowait
+  for(size_t tr = 0; tr < tiles_r; ++tr) {
+    for(size_t tc = 0; tc < tiles_c; ++tc) {
+      const size_t r0 = r_begin + tr*t_rows, r1 = std::min(r0 + t_rows, r_end);
+      const size_t c0 = c_begin + tc*t_cols, c1 = std::min(c0 + t_cols, c_end);
+
+      for(size_t r = r0; r < r1; ++r)
+        sum += sweep_row(src, dst, f_eval.data(), r, n_col, c0, c1, hh, residual);
     }
   }
 
-  update_error();
+  return sum;
 }
 
-void Mesh::update_error() { 
+template<typename T>
+double Mesh<T>::update_block_tiled(const size_t & r_begin, const size_t & r_end, const size_t & c_begin, const size_t & c_end, const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to update a block of the mesh using the Jacobi method on tiles of tile_rows x tile_cols points - openMP parallel version
+   * @note it reads from mesh_old and writes into mesh like update_block, a tile keeps its rows of mesh_old in cache
+   * while they are reused by the rows above and below
+   * @param r_begin is the first row to update
+   * @param r_end is the row after the last one to update
+   * @param c_begin is the first column to update
+   * @param c_end is the column after the last one to update
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to compute also the squared difference with mesh_old in the same loop
+   * @return sum of the squared differences of the block with mesh_old, 0 if residual is false
+  */
+
+  double sum = 0;
+
+  #pragma omp parallel num_threads(n_tasks) reduction(+:sum)
+  sum += update_block_team(r_begin, r_end, c_begin, c_end, true, residual);
+
+  return sum;
+}
+
+template<typename T>
+void Mesh<T>::update_tiled(const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to update the mesh using the Jacobi method with the tiled kernel - openMP parallel version
+   * @note the error is updated in the same sweep, if it is not asked the previous error is kept
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to update also the error
+  */
+
+  // swap the meshes, in this way the useless value are overwrite
+  std::swap(mesh, mesh_old);
+
+  const double sum = update_block_tiled(1, n_row - 1, 1, n_col - 1, n_tasks, residual);
+
+  if(residual)
+    error = std::sqrt(h*sum);
+}
+
+template<typename T>
+void Mesh<T>::update_wavefront(const int & steps, const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to do several Jacobi sweeps in a single pass over the mesh with a wavefront - openMP parallel version
+   * @note sweep s updates row w - 2(s - 1) at wavefront w, so the rows it reads from sweep s - 1 are already computed and
+   * the rows of sweep s - 2 it overwrites are no more needed, the two buffers are enough for any number of sweeps.
+   * The rows of the same wavefront are independent and they are split in column chunks among the threads.
+   * At the end mesh is the last sweep and mesh_old the previous one, as after steps calls of update_par.
+   * It needs the boundary of the whole mesh, so it is used only without MPI ghost cells.
+   * @param steps is the number of Jacobi sweeps
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to update also the error, with the difference between the last two sweeps
+  */
+
+  const size_t n_steps = std::max(steps, 1);
+  const size_t rows = n_row - 2, cols = n_col - 2;
+
+  // both buffers are read at some sweep, so both need the boundary values
+  for(size_t c = 0; c < n_col; ++c){
+    mesh_old[c] = mesh[c];
+    mesh_old[(n_row - 1)*n_col + c] = mesh[(n_row - 1)*n_col + c];
+  }
+  for(size_t r = 0; r < n_row; ++r){
+    mesh_old[r*n_col] = mesh[r*n_col];
+    mesh_old[r*n_col + n_col - 1] = mesh[r*n_col + n_col - 1];
+  }
+
+  // Precompute constant values outside the loop
+  const T hh = h * h;
+  const size_t chunks = std::min<size_t>(std::max(n_tasks, 1), (cols + 63)/64);
+  const size_t chunk = (cols + chunks - 1)/chunks;
+
+  // sweep s reads buffers[(s - 1)%2] and writes buffers[s%2]
+  const std::array<T *, 2> buffers = {mesh.data(), mesh_old.data()};
+
+  double sum = 0;
+
+  #pragma omp parallel num_threads(n_tasks) reduction(+:sum)
+  for(size_t w = 1; w <= rows + 2*(n_steps - 1); ++w) {
+    #pragma omp for collapse(2) schedule(static)
+    for(size_t s = 1; s <= n_steps; ++s) {
+      for(size_t k = 0; k < chunks; ++k) {
+        // the row of sweep s at wavefront w, if any
+        if(w < 2*(s - 1) + 1 || w - 2*(s - 1) > rows)
+          continue;
+
+        const size_t r = w - 2*(s - 1);
+        const size_t c0 = 1 + k*chunk, c1 = std::min(c0 + chunk, cols + 1);
+        if(c0 < c1)
+          sum += sweep_row(buffers[(s - 1)%2], buffers[s%2], f_eval.data(), r, n_col, c0, c1, hh, residual && s == n_steps);
+      }
+    }
+  }
+
+  // the last sweep is in mesh_old when the number of sweeps is odd
+  if(n_steps%2 == 1)
+    std::swap(mesh, mesh_old);
+
+  if(residual)
+    error = std::sqrt(h*sum);
+}
+
+template<typename T>
+double Mesh<T>::update_color_row(const size_t & r, const int & color, const T & omega, const T & hh, const bool & residual) {
+  /**
+   * @brief Function to update the points of one colour of a row using the red-black Gauss-Seidel method with over-relaxation
+   * @param r is the row to update
+   * @param color is 0 for red points and 1 for black points
+   * @param omega is the relaxation factor, 1 is plain Gauss-Seidel
+   * @param hh is the square of the step of the mesh
+   * @param residual is true to compute also the squared difference with the previous value
+   * @return sum of the squared differences of the updated points, 0 if residual is false
+  */
+
+  // first column of the row with the right colour
+  const size_t c_begin = 1 + (color + r + offset + col_offset + 1)%2;
+
+  double sum = 0;
+
+  for(size_t c = c_begin; c < n_col - 1; c += 2) {
+    const T gs = T(0.25)*(mesh[(r-1)*n_col + c] + mesh[(r+1)*n_col + c] + mesh[r*n_col + (c-1)] + mesh[r*n_col + (c+1)] + hh*f_eval[r*n_col + c]);
+    const T diff = omega*(gs - mesh[r*n_col + c]);
+    if(residual)
+      sum += diff*diff;
+    mesh[r*n_col + c] += diff;
+  }
+
+  return sum;
+}
+
+template<typename T>
+double Mesh<T>::update_color(const int & color, const double & omega, const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to update the points of one colour of the mesh using the red-black Gauss-Seidel method with over-relaxation - openMP parallel version
+   * @note the update is done in place on mesh, the colour of a point is the parity of the sum of its global indexes so
+   * all the neighbours of a point have the other colour and the points of one colour can be updated in parallel
+   * @param color is 0 for red points and 1 for black points
+   * @param omega is the relaxation factor, 1 is plain Gauss-Seidel
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to compute also the squared difference with the previous value
+   * @return sum of the squared differences of the updated points, 0 if residual is false
+  */
+
+  // Precompute constant values outside the loop
+  const T hh = h * h;
+
+  double sum = 0;
+
+  #pragma omp parallel for num_threads(n_tasks) reduction(+:sum)
+  for(size_t r = 1; r < n_row - 1; ++r)
+    sum += update_color_row(r, color, omega, hh, residual);
+
+  return sum;
+}
+
+template<typename T>
+double Mesh<T>::update_color_team(const int & color, const double & omega, const bool & residual) {
+  /**
+   * @brief Function to update the points of one colour of the mesh, shared among the threads of the enclosing parallel region
+   * @note it has to be called by all the threads of the team, there is no barrier at the end
+   * @param color is 0 for red points and 1 for black points
+   * @param omega is the relaxation factor, 1 is plain Gauss-Seidel
+   * @param residual is true to compute also the squared difference with the previous value
+   * @return sum of the squared differences of the points updated by the calling thread, 0 if residual is false
+  */
+
+  // Precompute constant values outside the loop
+  const T hh = h * h;
+
+  double sum = 0;
+
+  #pragma omp for schedule(static) nowait
+  for(size_t r = 1; r < n_row - 1; ++r)
+    sum += update_color_row(r, color, omega, hh, residual);
+
+  return sum;
+}
+
+template<typename T>
+void Mesh<T>::first_touch(const int & n_tasks, const bool & tiled) {
+  /**
+   * @brief Function to move mesh, mesh_old and f_eval to new storage first written by the threads which update it
+   * @note the pages of memory are placed on the NUMA node of the thread which writes them first: the interior points are copied
+   * with the loop and the static schedule of update_block_team (tiles with collapse(2), or rows, which are also the rows of
+   * update_color_team), the boundary columns with the first and the last tile of their row, and the first and the last row by the
+   * master thread, which exchanges them. The threads are bound (proc_bind close) as in the parallel region of the iterations.
+   * It is done once for each team and tile, the trials and the refinements assign the meshes into the same storage
+   * @param n_tasks is the number of parallel tasks
+   * @param tiled is true to place the tiles of tile_rows x tile_cols points of the tiled kernel, false for whole rows
+  */
+
+  if(n_row < 3 || n_col < 3)
+    return;
+
+  const size_t t_rows = tiled ? tile_rows : 1;
+  const size_t t_cols = tiled ? tile_cols : n_col - 2;
+  const std::array<size_t, 3> layout = {static_cast<size_t>(n_tasks), t_rows, t_cols};
+  if(layout == placement)
+    return;
+  placement = layout;
+
+  const size_t tiles_r = (n_row - 2 + t_rows - 1)/t_rows;
+  const size_t tiles_c = (n_col - 2 + t_cols - 1)/t_cols;
+
+  // the allocator doesn't initialise the values, so no page is touched here
+  aligned_vector<T> new_mesh(mesh.size()), new_mesh_old(mesh_old.size()), new_f_eval(f_eval.size());
+
+  auto copy = [&](const size_t & r, const size_t & c_begin, const size_t & c_end) {
+    const size_t first = r*n_col + c_begin, last = r*n_col + c_end;
+    std::copy(mesh.begin() + first, mesh.begin() + last, new_mesh.begin() + first);
+    std::copy(mesh_old.begin() + first, mesh_old.begin() + last, new_mesh_old.begin() + first);
+    std::copy(f_eval.begin() + first, f_eval.begin() + last, new_f_eval.begin() + first);
+  };
+
+  #pragma omp parallel num_threads(n_tasks) proc_bind(close)
+  {
+    #pragma omp master
+    {
+      copy(0, 0, n_col);
+      copy(n_row - 1, 0, n_col);
+    }
+
+    #pragma omp for collapse(2) schedule(static)
+    for(size_t tr = 0; tr < tiles_r; ++tr) {
+      for(size_t tc = 0; tc < tiles_c; ++tc) {
+        const size_t r0 = 1 + tr*t_rows, r1 = std::min(r0 + t_rows, n_row - 1);
+        const size_t c0 = tc == 0 ? 0 : 1 + tc*t_cols;
+        const size_t c1 = tc == tiles_c - 1 ? n_col : 1 + (tc + 1)*t_cols;
+
+        for(size_t r = r0; r < r1; ++r)
+          copy(r, c0, c1);
+      }
+    }
+  }
+
+  mesh.swap(new_mesh);
+  mesh_old.swap(new_mesh_old);
+  f_eval.swap(new_f_eval);
+}
+
+template<typename T>
+void Mesh<T>::update_red_black(const double & omega, const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to update the mesh using the red-black Gauss-Seidel method (SOR if omega is not 1) - openMP parallel version
+   * @note the error is updated in the same sweep, if it is not asked the previous error is kept
+   * @param omega is the relaxation factor
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to update also the error
+  */
+
+  double sum = update_color(0, omega, n_tasks, residual);
+  sum += update_color(1, omega, n_tasks, residual);
+
+  if(residual)
+    error = std::sqrt(h*sum);
+}
+
+template<typename T>
+double Mesh<T>::optimal_omega() const {
+  /**
+   * @brief Function to estimate the optimal relaxation factor of SOR for the Laplace problem
+   * @note it comes from the spectral radius of Jacobi, cos(pi/N) with N intervals on each side
+   * @return the relaxation factor
+  */
+
+  const double intervals = (domain.y1 - domain.y0)/h;
+  return 2/(1 + std::sin(M_PI/intervals));
+}
+
+template<typename T>
+void Mesh<T>::update_error() { 
   /**
    * @brief Function to update the error of the current mesh with the previous one
   */
 
-  error = 0;
+  double sum = 0;
 
-  #pragma omp parallel for reduction(+:error)
+  #pragma omp parallel for reduction(+:sum)
   for(size_t i = 1; i < n_row - 1; ++i) 
     for(size_t j = 1; j < n_col - 1; ++j) 
-      error += (mesh[i*n_col + j] - mesh_old[i*n_col + j])*(mesh[i*n_col + j] - mesh_old[i*n_col + j]);
+      sum += (mesh[i*n_col + j] - mesh_old[i*n_col + j])*(mesh[i*n_col + j] - mesh_old[i*n_col + j]);
     
-  error = std::sqrt(h*error);
+  error = std::sqrt(h*sum);
+}
+
+template<typename T>
+void Mesh<T>::residual(aligned_vector<T> & r, const int & n_tasks) const {
+  /**
+   * @brief Function to compute the residual f + laplacian(u) of the discrete problem on the mesh
+   * @param r is the vector where the residual is saved, it is zero outside the computed points
+   * @param n_tasks is the number of parallel tasks
+  */
+
+  r.assign(n_row*n_col, 0);
+
+  // Precompute constant values outside the loop
+  const T hh = h * h;
+
+  #pragma omp parallel for num_threads(n_tasks)
+  for(size_t i = 1; i < n_row - 1; ++i)
+    for(size_t j = 1; j < n_col - 1; ++j)
+      r[i*n_col + j] = f_eval[i*n_col + j] + (mesh[(i-1)*n_col + j] + mesh[(i+1)*n_col + j] + mesh[i*n_col + (j-1)] + mesh[i*n_col + (j+1)] - 4*mesh[i*n_col + j])/hh;
 }
 
-void Mesh::set_boundary(const size_t & idx, const std::vector<double> & value, const bool & isColumn){
+template<typename T>
+void Mesh<T>::set_boundary(const size_t & idx, const std::vector<T> & value, const bool & isColumn){
   /**
    * @brief Function to set the boundary of the mesh
    * @param idx is the index of the boundary
@@ -182,10 +667,12 @@ void Mesh::set_boundary(const size_t & idx, const std::vector<double> & value, c
   }
 }
 
-std::optional<std::string> Mesh::add_boundary_condition(const std::string & _f){
+template<typename T>
+std::optional<std::string> Mesh<T>::add_boundary_condition(const std::string & _f, const std::array<bool, 4> & sides){
   /**
    * @brief Function to add a boundary condition to the mesh
    * @param _f is the function of the boundary condition
+   * @param sides tells which of first row, last row, first column and last column of the mesh are on the boundary of the domain
   */
 
   mu::Parser b_parser;
@@ -199,17 +686,34 @@ std::optional<std::string> Mesh::add_boundary_condition(const std::string & _f){
     return e.GetMsg();
   }
 
-  // add first row and last row
+  // points of the boundary: first and last row, then first and last column
+  std::vector<size_t> idx;
+  idx.reserve(2*(n_row + n_col));
   for(size_t i = 0; i < n_col; ++i){
-    mesh[i] = f(get_coordinates(0, i).first, get_coordinates(0, i).second, b_parser);
-    mesh[(n_row - 1)*n_col + i] = f(get_coordinates(n_row - 1, i).first, get_coordinates(n_row - 1, i).second, b_parser);
+    if(sides[0])
+      idx.push_back(i);
+    if(sides[1])
+      idx.push_back((n_row - 1)*n_col + i);
   }
-
-  // add first column and last column
   for(size_t i = 0; i < n_row; ++i){
-    mesh[i*n_col] = f(get_coordinates(i, 0).first, get_coordinates(i, 0).second, b_parser);
-    mesh[i*n_col + n_col - 1] = f(get_coordinates(i, n_col - 1).first, get_coordinates(i, n_col - 1).second, b_parser);
+    if(sides[2])
+      idx.push_back(i*n_col);
+    if(sides[3])
+      idx.push_back(i*n_col + n_col - 1);
   }
 
+  std::vector<double> x(idx.size()), y(idx.size()), values(idx.size());
+  for(size_t k = 0; k < idx.size(); ++k)
+    std::tie(x[k], y[k]) = get_coordinates(idx[k]/n_col, idx[k]%n_col);
+
+  evaluate(b_parser, x, y, values.data());
+
+  // both meshes are read by the updates, so both need the boundary
+  for(size_t k = 0; k < idx.size(); ++k)
+    mesh[idx[k]] = mesh_old[idx[k]] = values[k];
+
   return std::nullopt;
-}
\ No newline at end of file
+}
+
+template class Mesh<float>;
+template class Mesh<double>;
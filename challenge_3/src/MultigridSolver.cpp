@@ -0,0 +1,425 @@
+#include "MultigridSolver.hpp"
+
+template<typename T>
+MultigridSolver<T>::MultigridSolver(std::vector<T> & _mesh, const Domain & d, const size_t & n_col, const std::string & f) : Solver<T>(_mesh, d, n_col, f){
+  /**
+   * @brief Constructor of the MultigridSolver class, each process owns a slab of rows
+   * @param _mesh is the mesh to be solved
+   * @param d is the domain of the mesh
+   * @param n_col is the number of points of column of the mesh
+   * @param f is the function to be computed
+  */
+}
+
+template<typename T>
+MultigridSolver<T>::MultigridSolver(const size_t & n, const Domain & d, const std::string & f) : Solver<T>(n, d, f){
+  /**
+   * @brief Constructor of the MultigridSolver class with a 2D Cartesian decomposition of the mesh
+   * @param n is the number of points of each side of the whole mesh
+   * @param d is the domain of the mesh
+   * @param f is the function to be computed
+  */
+}
+
+template<typename T>
+MultigridSolver<T>::MultigridSolver(Mesh<T> & m) : Solver<T>(m){
+  /**
+   * @brief Constructor of the MultigridSolver class
+   * @param m is the mesh to be solved
+  */
+}
+
+template<typename T>
+void MultigridSolver<T>::restriction(const aligned_vector<T> & fine, const size_t & rows, const size_t & cols, const int & row_off, const int & col_off,
+                                  const size_t & n_fine, aligned_vector<T> & coarse, const size_t & c_rows, const size_t & c_cols, const int & c_row_off,
+                                  const int & c_col_off, const size_t & n_coarse, const int & n_tasks){
+  /**
+   * @brief Function to add the restriction of a (block of a) fine residual to (a block of) the coarse residual
+   * @note it is the transpose of the bilinear prolongation scaled by (h_fine/h_coarse)^2, so it is full weighting when
+   * the levels are nested and it still works when n_fine - 1 is odd. The coarse block has to hold the coarse points next to
+   * the fine one, as the blocks of Solver::coarse_block do with their ghost cells
+   * @param fine is the fine vector, only its computed points are restricted
+   * @param rows is the number of rows of fine
+   * @param cols is the number of columns of fine
+   * @param row_off is the global row of the first row of fine
+   * @param col_off is the global column of the first column of fine
+   * @param n_fine is the number of points of each side of the whole fine level
+   * @param coarse is the coarse vector where the restriction is added
+   * @param c_rows is the number of rows of coarse
+   * @param c_cols is the number of columns of coarse
+   * @param c_row_off is the global row of the first row of coarse
+   * @param c_col_off is the global column of the first column of coarse
+   * @param n_coarse is the number of points of each side of the whole coarse level
+   * @param n_tasks is the number of parallel tasks
+  */
+
+  const double s = scale(n_fine, n_coarse);
+
+  // computed points of fine, in global indexes
+  const int r_first = row_off + 1, r_last = row_off + rows - 2;
+  const int c_first = col_off + 1, c_last = col_off + cols - 2;
+
+  // interior coarse points of the coarse block inside the support of the fine points
+  const int i_begin = std::max({1, c_row_off, static_cast<int>(std::floor(r_first*s))});
+  const int i_end = std::min({static_cast<int>(n_coarse) - 2, c_row_off + static_cast<int>(c_rows) - 1, static_cast<int>(std::ceil(r_last*s))});
+  const int j_begin = std::max({1, c_col_off, static_cast<int>(std::floor(c_first*s))});
+  const int j_end = std::min({static_cast<int>(n_coarse) - 2, c_col_off + static_cast<int>(c_cols) - 1, static_cast<int>(std::ceil(c_last*s))});
+
+  #pragma omp parallel for num_threads(n_tasks)
+  for(int i = i_begin; i <= i_end; ++i){
+    // fine rows inside the hat function of the coarse row i
+    const int a_begin = std::max(r_first, static_cast<int>(std::floor((i - 1)/s))), a_end = std::min(r_last, static_cast<int>(std::ceil((i + 1)/s)));
+
+    for(int j = j_begin; j <= j_end; ++j){
+      const int b_begin = std::max(c_first, static_cast<int>(std::floor((j - 1)/s))), b_end = std::min(c_last, static_cast<int>(std::ceil((j + 1)/s)));
+
+      double sum = 0;
+      for(int a = a_begin; a <= a_end; ++a){
+        const double wa = 1 - std::abs(a*s - i);
+        if(wa <= 0)
+          continue;
+        for(int b = b_begin; b <= b_end; ++b){
+          const double wb = 1 - std::abs(b*s - j);
+          if(wb > 0)
+            sum += wa*wb*fine[(a - row_off)*cols + (b - col_off)];
+        }
+      }
+
+      coarse[(i - c_row_off)*c_cols + (j - c_col_off)] += s*s*sum;
+    }
+  }
+}
+
+template<typename T>
+void MultigridSolver<T>::prolongation(const aligned_vector<T> & coarse, const size_t & c_cols, const int & c_row_off, const int & c_col_off,
+                                   const size_t & n_coarse, aligned_vector<T> & fine, const size_t & rows, const size_t & cols, const int & row_off,
+                                   const int & col_off, const size_t & n_fine, const int & n_tasks){
+  /**
+   * @brief Function to add the bilinear interpolation of (a block of) a coarse correction to (a block of) a fine vector
+   * @note the coarse block has to hold the coarse points next to the fine one, ghost cells included
+   * @param coarse is the coarse correction, zero on the boundaries
+   * @param c_cols is the number of columns of coarse
+   * @param c_row_off is the global row of the first row of coarse
+   * @param c_col_off is the global column of the first column of coarse
+   * @param n_coarse is the number of points of each side of the whole coarse level
+   * @param fine is the fine vector, only its computed points are corrected
+   * @param rows is the number of rows of fine
+   * @param cols is the number of columns of fine
+   * @param row_off is the global row of the first row of fine
+   * @param col_off is the global column of the first column of fine
+   * @param n_fine is the number of points of each side of the whole fine level
+   * @param n_tasks is the number of parallel tasks
+  */
+
+  const double s = scale(n_fine, n_coarse);
+
+  #pragma omp parallel for num_threads(n_tasks)
+  for(size_t r = 1; r < rows - 1; ++r){
+    const double x = (r + row_off)*s;
+    const size_t i = std::min<size_t>(x, n_coarse - 2);
+    const double t = x - i;
+    const T * up = coarse.data() + (i - c_row_off)*c_cols, * down = up + c_cols;
+
+    for(size_t c = 1; c < cols - 1; ++c){
+      const double y = (c + col_off)*s;
+      const size_t j = std::min<size_t>(y, n_coarse - 2);
+      const double u = y - j;
+      const size_t k = j - c_col_off;
+
+      fine[r*cols + c] += (1 - t)*(1 - u)*up[k] + t*(1 - u)*down[k] + (1 - t)*u*up[k + 1] + t*u*down[k + 1];
+    }
+  }
+}
+
+template<typename T>
+void MultigridSolver<T>::build_levels(){
+  /**
+   * @brief Function to build the hierarchy of coarse levels, halving the intervals until 3 interior points are left
+   * @note a level is distributed while it has more than gather_points points of each side and every process owns at least one of its
+   * points in each direction, the following levels are stored by rank 0. The vectors of the cycles are allocated here once
+  */
+
+  level_points.clear();
+  blocks.clear();
+  levels.clear();
+  residuals.clear();
+  restricted.clear();
+
+  for(size_t n = n_points; n > 5; ){
+    n = (n - 1)/2 + 1;
+    level_points.push_back(n);
+  }
+
+  if(level_points.empty())
+    return;
+
+  residuals.emplace_back(n_row*n_col, 0);
+
+  // coarse levels solve the error equation, so they have homogeneous boundary conditions
+  Solver<T> * fine = this;
+  for(auto & n : level_points){
+    if(size == 1 || n <= gather_points)
+      break;
+
+    const auto rows = Solver<T>::coarse_block(fine->offset, fine->n_row, fine->n_points, n);
+    const auto cols = Solver<T>::coarse_block(fine->col_offset, fine->n_col, fine->n_points, n);
+    int owned = std::min(rows[0], cols[0]) - 2;
+    MPI_Allreduce(MPI_IN_PLACE, &owned, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if(owned < 1)
+      break;
+
+    blocks.push_back(std::make_unique<Solver<T>>(*fine, n));
+    fine = blocks.back().get();
+    fine->f_eval.assign(fine->n_row*fine->n_col, 0);
+    residuals.emplace_back(fine->n_row*fine->n_col, 0);
+  }
+
+  // the first level of rank 0 is restricted by every process
+  restricted.emplace_back(level_points[blocks.size()]*level_points[blocks.size()], 0);
+
+  if(rank == 0)
+    for(size_t k = blocks.size(); k < level_points.size(); ++k){
+      const size_t n = level_points[k];
+      levels.emplace_back(n, n, domain, f_str);
+      if(k > blocks.size())
+        restricted.emplace_back(n*n, 0);
+      if(k < level_points.size() - 1)
+        residuals.emplace_back(n*n, 0);
+    }
+}
+
+template<typename T>
+void MultigridSolver<T>::v_cycle(const size_t & level, const conditions & c, const int & n_tasks){
+  /**
+   * @brief Function to apply a V-cycle on a coarse level of rank 0 (rank 0 only)
+   * @param level is the index of the coarse level among the ones of rank 0
+   * @param c are the conditions of the solver
+   * @param n_tasks is the number of parallel tasks
+  */
+
+  Mesh<T> & m = levels[level];
+
+  // the coarsest level is small enough to be solved by smoothing
+  if(level == levels.size() - 1){
+    for(int i = 0; i < 50; ++i)
+      m.update_red_black(1, 1, false);
+    return;
+  }
+
+  for(int i = 0; i < c.pre_smoothing; ++i)
+    m.update_red_black(1, n_tasks, false);
+
+  // restrict the residual as right hand side of the next level
+  const size_t n = level_points[blocks.size() + level], n_next = level_points[blocks.size() + level + 1];
+  aligned_vector<T> & r = residuals[blocks.size() + level + 1], & r_coarse = restricted[level + 1];
+  m.residual(r, n_tasks);
+  std::fill(r_coarse.begin(), r_coarse.end(), 0);
+  restriction(r, n, n, 0, 0, n, r_coarse, n_next, n_next, 0, 0, n_next, n_tasks);
+
+  Mesh<T> & next = levels[level + 1];
+  next.set_f_eval(r_coarse);
+  std::fill(next.get_mesh().begin(), next.get_mesh().end(), 0);
+
+  v_cycle(level + 1, c, n_tasks);
+
+  prolongation(next.get_mesh(), n_next, 0, 0, n_next, m.get_mesh(), n, n, 0, 0, n, n_tasks);
+
+  for(int i = 0; i < c.post_smoothing; ++i)
+    m.update_red_black(1, n_tasks, false);
+}
+
+template<typename T>
+void MultigridSolver<T>::correction(Solver<T> & fine, const size_t & level, const conditions & c, const int & n_tasks){
+  /**
+   * @brief Function to add to a distributed level the correction of the next coarse level
+   * @note the residual is restricted by each process on its block: a distributed coarse level receives from the neighbours the
+   * contributions to the points of its block and is smoothed and corrected in turn, the first level of rank 0 gets the residual
+   * summed with MPI_Reduce and broadcasts its correction
+   * @param fine is the finest level (this solver) or a distributed coarse level
+   * @param level is the index of the coarse level
+   * @param c are the conditions of the solver
+   * @param n_tasks is the number of parallel tasks
+  */
+
+  aligned_vector<T> & r = residuals[level];
+  fine.residual(r, n_tasks);
+
+  if(level < blocks.size()){
+    Solver<T> & next = *blocks[level];
+
+    std::fill(next.f_eval.begin(), next.f_eval.end(), 0);
+    restriction(r, fine.n_row, fine.n_col, fine.offset, fine.col_offset, fine.n_points,
+                next.f_eval, next.n_row, next.n_col, next.offset, next.col_offset, next.n_points, n_tasks);
+    next.accumulate_boundary(next.f_eval);
+    std::fill(next.mesh.begin(), next.mesh.end(), 0);
+
+    for(int i = 0; i < c.pre_smoothing; ++i)
+      next.update_red_black_mpi(1, n_tasks, false);
+
+    correction(next, level + 1, c, n_tasks);
+
+    for(int i = 0; i < c.post_smoothing; ++i)
+      next.update_red_black_mpi(1, n_tasks, false);
+
+    // the smoothing leaves the ghost cells of the correction up to date
+    prolongation(next.mesh, next.n_col, next.offset, next.col_offset, next.n_points,
+                 fine.mesh, fine.n_row, fine.n_col, fine.offset, fine.col_offset, fine.n_points, n_tasks);
+
+    // the exchanges of the coarse levels are counted with the ones of the finest level
+    times.halo += next.times.halo;
+    next.times.halo = 0;
+  }
+  else{
+    const size_t n = level_points[level];
+    aligned_vector<T> & coarse = restricted[0];
+
+    std::fill(coarse.begin(), coarse.end(), 0);
+    restriction(r, fine.n_row, fine.n_col, fine.offset, fine.col_offset, fine.n_points, coarse, n, n, 0, 0, n, n_tasks);
+
+    if(rank == 0){
+      MPI_Reduce(MPI_IN_PLACE, coarse.data(), coarse.size(), scalar_type(), MPI_SUM, 0, MPI_COMM_WORLD);
+
+      levels[0].set_f_eval(coarse);
+      std::fill(levels[0].get_mesh().begin(), levels[0].get_mesh().end(), 0);
+      v_cycle(0, c, n_tasks);
+      std::copy(levels[0].get_mesh().begin(), levels[0].get_mesh().end(), coarse.begin());
+    }
+    else{
+      MPI_Reduce(coarse.data(), nullptr, coarse.size(), scalar_type(), MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+
+    MPI_Bcast(coarse.data(), coarse.size(), scalar_type(), 0, MPI_COMM_WORLD);
+
+    prolongation(coarse, n, 0, 0, n, fine.mesh, fine.n_row, fine.n_col, fine.offset, fine.col_offset, fine.n_points, n_tasks);
+  }
+
+  fine.communicate_boundary();
+}
+
+template<typename T>
+void MultigridSolver<T>::cycle(const conditions & c, const int & n_tasks){
+  /**
+   * @brief Function to apply a V-cycle on the finest level, the error is the norm of the update of the whole cycle
+   * @param c are the conditions of the solver
+   * @param n_tasks is the number of parallel tasks
+  */
+
+  // Gauss-Seidel works in place, mesh_old keeps the previous iterate
+  mesh_old = mesh;
+
+  for(int i = 0; i < c.pre_smoothing; ++i)
+    update_red_black_mpi(1, n_tasks, false);
+
+  if(!level_points.empty())
+    correction(*this, 0, c, n_tasks);
+
+  for(int i = 0; i < c.post_smoothing; ++i)
+    update_red_black_mpi(1, n_tasks, false);
+
+  double sum = 0;
+
+  #pragma omp parallel for num_threads(n_tasks) reduction(+:sum)
+  for(size_t r = 1; r < n_row - 1; ++r)
+    for(size_t j = 1; j < n_col - 1; ++j)
+      sum += (mesh[r*n_col + j] - mesh_old[r*n_col + j])*(mesh[r*n_col + j] - mesh_old[r*n_col + j]);
+
+  error = std::sqrt(h*sum);
+}
+
+template<typename T>
+int MultigridSolver<T>::iterate(const int & thread){
+  /**
+   * @brief Function to apply V-cycles until convergence
+   * @note the time of the V-cycles, exchanges excluded, is counted as residual time since each of them computes the residual
+   * @param thread is the number of threads to be used by openMP
+   * @return the number of V-cycles
+  */
+
+  const conditions & c = cond;
+  int iter = first_iter;
+  int exit = 0;
+
+  for(int i = first_iter; i < c.n_max && exit < size; ++i){
+    const double start = MPI_Wtime(), halo = times.halo;
+    cycle(c, thread);
+    times.residual += MPI_Wtime() - start - (times.halo - halo);
+    ++iter;
+    exit = (get_error() < c.tolerance || i == c.n_max - 1) ? 1 : 0;
+
+    // Communicate local exit condition to all threads
+    const double t = MPI_Wtime();
+    MPI_Allreduce(MPI_IN_PLACE, &exit, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    times.allreduce += MPI_Wtime() - t;
+
+    periodic_output(i, i + 1);
+  }
+
+  const double t = MPI_Wtime();
+  finish_checkpoint();
+  times.output += MPI_Wtime() - t;
+
+  return iter;
+}
+
+template<typename T>
+std::optional<std::vector<T>> MultigridSolver<T>::solution_finder_sequential(const int & thread){
+  /**
+   * @brief Function to find the solution of the mesh with multigrid on a single process
+   * @param thread is the number of threads to be used by openMP
+  */
+
+  // Create evaluation of f and the coarse levels
+  double start = MPI_Wtime();
+  f_eval_creation();
+  build_levels();
+  times.setup += MPI_Wtime() - start;
+
+  run(thread);
+
+  #if TEST == 1
+  print_exact_distance();
+  #endif
+
+  // save the final mesh into a file
+  start = MPI_Wtime();
+  write_output();
+  times.output += MPI_Wtime() - start;
+
+  report(thread);
+
+  #if TEST == 1
+  return std::vector<T>(mesh.begin(), mesh.end());
+  #endif
+
+  return std::nullopt;
+}
+
+template<typename T>
+void MultigridSolver<T>::solution_finder_mpi(std::vector<T> & final_mesh, const int & thread){
+  /**
+   * @brief Function to find the solution of the mesh with multigrid using MPI
+   * @param final_mesh is the final mesh to be saved
+   * @param thread is the number of threads to be used by openMP
+  */
+
+  // Create evaluation of f and the coarse levels
+  double start = MPI_Wtime();
+  f_eval_creation(thread);
+  build_levels();
+  times.setup += MPI_Wtime() - start;
+
+  run(thread);
+
+  #if TEST == 1
+  print_exact_distance();
+  #endif
+
+  start = MPI_Wtime();
+  final_communication(final_mesh);
+  times.output += MPI_Wtime() - start;
+
+  report(thread);
+}
+
+template class MultigridSolver<float>;
+template class MultigridSolver<double>;
@@ -1,8 +1,11 @@
 #include "Solver.hpp"
 #include <array>
 #include <numeric>
+#include <fstream>
+#include <cstdio>
 
-Solver::Solver(std::vector<double> & _mesh, const Domain & d, const size_t & n_col, const std::string & f) : Mesh(_mesh, n_col, d, f){
+template<typename T>
+Solver<T>::Solver(std::vector<T> & _mesh, const Domain & d, const size_t & n_col, const std::string & f) : Mesh<T>(_mesh, n_col, d, f), n_points(n_col){
   /**
    * @brief Constructor of the Solver class
    * @param _mesh is the mesh to be solved
@@ -14,7 +17,42 @@ Solver::Solver(std::vector<double> & _mesh, const Domain & d, const size_t & n_c
   send_counts.reserve(size);
 }
 
-Solver::Solver(Mesh & m) : Mesh(m) {
+template<typename T>
+Solver<T>::Solver(const size_t & n, const Domain & d, const std::string & f) : Mesh<T>(cartesian_points(n, 0), cartesian_points(n, 1), d, f), n_points(n) {
+  /**
+   * @brief Constructor of the Solver class with a 2D Cartesian decomposition of the mesh
+   * @note each process owns a block of the interior points plus one ghost cell on each side
+   * @param n is the number of points of each side of the whole mesh
+   * @param d is the domain of the mesh
+   * @param f is the function to be computed
+  */
+
+  dims = cartesian_dims(size);
+  if(static_cast<size_t>(std::max(dims[0], dims[1])) > n - 2){
+    throw std::runtime_error("Too many processes for the Cartesian decomposition of the mesh");
+  }
+
+  // processes keep their rank inside the Cartesian communicator
+  std::array<int, 2> periods = {0, 0};
+  MPI_Cart_create(MPI_COMM_WORLD, 2, dims.data(), periods.data(), 0, &cart_comm);
+  MPI_Cart_shift(cart_comm, 0, 1, &neighbours[0], &neighbours[1]);
+  MPI_Cart_shift(cart_comm, 1, 1, &neighbours[2], &neighbours[3]);
+
+  // the step is given by the points of the whole mesh, not by the local columns
+  h = (domain.y1 - domain.y0)/(n - 1);
+
+  // offsets to correctly find x and y during calculations
+  auto block = cartesian_block(rank);
+  offset = block[2];
+  col_offset = block[3];
+
+  // a column of ghost cells is not contiguous in memory
+  MPI_Type_vector(n_row - 2, 1, n_col, scalar_type(), &column_type);
+  MPI_Type_commit(&column_type);
+}
+
+template<typename T>
+Solver<T>::Solver(Mesh<T> & m) : Mesh<T>(m), n_points(m.get_size().second) {
   /**
    * @brief Constructor of the Solver class
    * @param m is the mesh to be solved
@@ -24,7 +62,158 @@ Solver::Solver(Mesh & m) : Mesh(m) {
   send_counts.reserve(size);
 }
 
-void Solver::print_mesh() const{
+template<typename T>
+Solver<T>::Solver(const Solver & fine, const size_t & n) : Mesh<T>(coarse_block(fine.offset, fine.n_row, fine.n_points, n)[0],
+  coarse_block(fine.col_offset, fine.n_col, fine.n_points, n)[0], fine.domain, fine.f_str), dims(fine.dims), neighbours(fine.neighbours),
+  n_points(n), cond(fine.cond) {
+  /**
+   * @brief Constructor of the block of a coarser level of the mesh, on the same processes with the same decomposition, used by multigrid
+   * @note each process owns the coarse points which lie inside its fine block (see coarse_block), so the coarse points read by the
+   * interpolation and written by the restriction of a block are its own points or its ghost cells
+   * @param fine is the solver of the finer level
+   * @param n is the number of points of each side of the coarse level
+  */
+
+  h = (domain.y1 - domain.y0)/(n - 1);
+  offset = coarse_block(fine.offset, fine.n_row, fine.n_points, n)[1];
+  col_offset = coarse_block(fine.col_offset, fine.n_col, fine.n_points, n)[1];
+
+  if(fine.is_cartesian()){
+    MPI_Comm_dup(fine.cart_comm, &cart_comm);
+    MPI_Type_vector(n_row - 2, 1, n_col, scalar_type(), &column_type);
+    MPI_Type_commit(&column_type);
+  }
+}
+
+template<typename T>
+template<typename U>
+Solver<T>::Solver(const Solver<U> & other) : Mesh<T>(other.n_row, other.n_col, other.domain, other.f_str), send_counts(other.send_counts),
+  dims(other.dims), neighbours(other.neighbours), n_points(other.n_points), cond(other.cond), first_iter(other.first_iter) {
+  /**
+   * @brief Constructor of a copy of a solver with values of another type, used by the mixed precision solver
+   * @note the copy owns the same block of the mesh, with its own Cartesian communicator and datatype of the ghost columns
+   * @param other is the solver to be copied
+  */
+
+  h = other.h;
+  offset = other.offset;
+  col_offset = other.col_offset;
+  error = other.error;
+  set_tiles(other.tile_rows, other.tile_cols);
+
+  mesh.assign(other.mesh.begin(), other.mesh.end());
+  mesh_old.assign(other.mesh_old.begin(), other.mesh_old.end());
+  f_eval.assign(other.f_eval.begin(), other.f_eval.end());
+
+  if(other.is_cartesian()){
+    MPI_Comm_dup(other.cart_comm, &cart_comm);
+    MPI_Type_vector(n_row - 2, 1, n_col, scalar_type(), &column_type);
+    MPI_Type_commit(&column_type);
+  }
+}
+
+template<typename T>
+Solver<T>::~Solver(){
+  /**
+   * @brief Destructor of the Solver class, it frees the MPI objects of the Cartesian decomposition
+  */
+
+  if(column_type != MPI_DATATYPE_NULL)
+    MPI_Type_free(&column_type);
+  if(cart_comm != MPI_COMM_NULL)
+    MPI_Comm_free(&cart_comm);
+}
+
+template<typename T>
+std::vector<int> Solver<T>::distribute(const int & points, const int & parts){
+  /**
+   * @brief Function to distribute equally points among parts
+   * @param points is the number of points to distribute
+   * @param parts is the number of parts
+   * @return number of points of each part, the remainder goes to the first parts
+  */
+
+  std::vector<int> temp(parts, points/parts);
+  for(int i = 0; i < points%parts; ++i)
+    ++temp[i];
+
+  return temp;
+}
+
+template<typename T>
+std::array<int, 2> Solver<T>::cartesian_dims(const int & n_process){
+  /**
+   * @brief Function to calculate the grid of processes of the Cartesian decomposition
+   * @param n_process is the number of processes
+   * @return number of processes along rows and columns
+  */
+
+  std::array<int, 2> d = {0, 0};
+  MPI_Dims_create(n_process, 2, d.data());
+  return d;
+}
+
+template<typename T>
+size_t Solver<T>::cartesian_points(const size_t & n, const int & dim){
+  /**
+   * @brief Function to calculate the points of the block of this process along one dimension
+   * @note it is used before the Cartesian communicator exists, so it relies on the row-major order of the ranks in it
+   * @param n is the number of points of each side of the whole mesh
+   * @param dim is 0 for rows and 1 for columns
+   * @return number of points along dim, ghost cells included
+  */
+
+  int r, s;
+  MPI_Comm_rank(MPI_COMM_WORLD, &r);
+  MPI_Comm_size(MPI_COMM_WORLD, &s);
+
+  auto d = cartesian_dims(s);
+  int coord = dim == 0 ? r/d[1] : r%d[1];
+
+  return distribute(n - 2, d[dim])[coord] + 2;
+}
+
+template<typename T>
+std::array<int, 4> Solver<T>::cartesian_block(const int & process) const{
+  /**
+   * @brief Function to find the block of the mesh owned by a process of the Cartesian decomposition
+   * @param process is the rank of the process
+   * @return rows, columns (ghost cells included) and global row and column of the first ghost cell
+  */
+
+  std::array<int, 2> coords;
+  MPI_Cart_coords(cart_comm, process, 2, coords.data());
+
+  auto rows = distribute(n_points - 2, dims[0]);
+  auto cols = distribute(n_points - 2, dims[1]);
+
+  return {rows[coords[0]] + 2, cols[coords[1]] + 2,
+          std::accumulate(rows.begin(), rows.begin() + coords[0], 0),
+          std::accumulate(cols.begin(), cols.begin() + coords[1], 0)};
+}
+
+template<typename T>
+std::array<int, 2> Solver<T>::coarse_block(const int & offset, const size_t & points, const size_t & n_fine, const size_t & n_coarse){
+  /**
+   * @brief Function to find the block of a coarse level which lies inside a block of a fine level, along one dimension
+   * @note the coarse point i is at the fine position i*(n_fine - 1)/(n_coarse - 1), it belongs to the block of the fine point
+   * at or just before it, so the blocks of the coarse level cover it once as the fine ones
+   * @param offset is the global index of the first ghost cell of the fine block
+   * @param points is the number of points of the fine block, ghost cells included
+   * @param n_fine is the number of points of each side of the fine level
+   * @param n_coarse is the number of points of each side of the coarse level
+   * @return number of points of the coarse block (ghost cells included) and global index of its first ghost cell
+  */
+
+  // first coarse point at or after the fine point k
+  auto first = [&](const int & k){ return static_cast<int>((k*(n_coarse - 1) + n_fine - 2)/(n_fine - 1)); };
+
+  const int begin = first(offset + 1), end = first(offset + points - 1);
+  return {end - begin + 2, begin - 1};
+}
+
+template<typename T>
+void Solver<T>::print_mesh() const{
   /**
    * @brief Function to print the mesh and rank who is printing
   */
@@ -41,70 +230,426 @@ void Solver::print_mesh() const{
   std::cout << std::endl;
 }
 
-std::optional<std::vector<double>> Solver::solution_finder_sequential(){
+template<typename T>
+std::optional<std::vector<T>> Solver<T>::solution_finder_sequential(const int & thread){
   /**
-   * @brief Function to find the solution of the mesh totally sequentially
+   * @brief Function to find the solution of the mesh on a single process
+   * @param thread is the number of threads to be used by openMP
   */
 
   // Create evaluation of f
+  double start = MPI_Wtime();
   f_eval_creation();
-
-  // Variables creation
-  conditions c;
-  int iter = 0;
-  double e = 10;
+  times.setup += MPI_Wtime() - start;
 
   // Sequential computation
-  auto start = std::chrono::high_resolution_clock::now();
-  for(int i = 0; i < c.n_max && e > c.tolerance; ++i){
-    update_par();
-    ++iter;
-    e = get_error();
-  }
-  auto end = std::chrono::high_resolution_clock::now();
-  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-  std::cout << "Time: " << duration.count() << " ms" << " - Iter: " << iter << std::endl;
+  run(thread);
 
-  // save the final mesh into the mesh of solver
-  mesh = get_mesh();
+  #if TEST == 1
+  print_exact_distance();
+  #endif
 
   // save the final mesh into a file
-  std::string filename = "vtk_files/approx_sol-1-" + std::to_string(n_row) + ".vtk";
-  write(filename);
+  start = MPI_Wtime();
+  write_output();
+  times.output += MPI_Wtime() - start;
+
+  report(thread);
 
   #if TEST == 1
-  return mesh;
+  return std::vector<T>(mesh.begin(), mesh.end());
   #endif
 
   return std::nullopt;
 }
 
-void Solver::communicate_boundary() {
+template<typename T>
+void Solver<T>::communicate_boundary() {
   /**
    * @brief Function to communicate the boundary of mesh inside each MPI process
    */
 
+  // a single process has only physical boundaries
+  if(size == 1)
+    return;
+
+  const double start = MPI_Wtime();
+  if(is_cartesian()){
+    start_communication_boundary(mesh.data());
+    MPI_Waitall(n_requests, requests.data(), MPI_STATUSES_IGNORE);
+    times.halo += MPI_Wtime() - start;
+    return;
+  }
+
   if (rank == 0) {
       // Send the last computed row to the next process and receive the first computed row from process 1
-      MPI_Sendrecv(&mesh[mesh.size() - 2*n_col], n_col, MPI_DOUBLE, 1, 0, &mesh[mesh.size() - n_col], n_col, MPI_DOUBLE, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      MPI_Sendrecv(&mesh[mesh.size() - 2*n_col], n_col, scalar_type(), 1, 0, &mesh[mesh.size() - n_col], n_col, scalar_type(), 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
   } else if (rank == size - 1) {
       // Send the first computed row to the previous process and receive the last computed row from the previous process
-      MPI_Sendrecv(&mesh[n_col], n_col, MPI_DOUBLE, rank - 1, 0, &mesh[0], n_col, MPI_DOUBLE, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      MPI_Sendrecv(&mesh[n_col], n_col, scalar_type(), rank - 1, 0, &mesh[0], n_col, scalar_type(), rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
   } else {
       // Send the first computed row to the previous process and receive the last computed row from the previous process
-      MPI_Sendrecv(&mesh[n_col], n_col, MPI_DOUBLE, rank - 1, 0, &mesh[0], n_col, MPI_DOUBLE, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      MPI_Sendrecv(&mesh[n_col], n_col, scalar_type(), rank - 1, 0, &mesh[0], n_col, scalar_type(), rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 
       // Send the last computed row to the next process and receive the first computed row from next process
-      MPI_Sendrecv(&mesh[mesh.size() - 2*n_col], n_col, MPI_DOUBLE, rank + 1, 0, &mesh[mesh.size() - n_col], n_col, MPI_DOUBLE, rank + 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      MPI_Sendrecv(&mesh[mesh.size() - 2*n_col], n_col, scalar_type(), rank + 1, 0, &mesh[mesh.size() - n_col], n_col, scalar_type(), rank + 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  }
+  times.halo += MPI_Wtime() - start;
+}
+
+template<typename T>
+void Solver<T>::start_communication_boundary(T * m) {
+  /**
+   * @brief Function to post the non-blocking exchange of the ghost cells of a mesh
+   * @note the exchange has to be completed with MPI_Waitall on requests before the cells next to the ghost ones are updated
+   * @param m are the values of the mesh (mesh or mesh_old, also on the device with an MPI aware of device memory) whose ghost cells are exchanged
+   */
+
+  if(is_cartesian()){
+    const int len = n_col - 2;
+
+    // Receive the ghost rows and columns from the neighbours, corners are not used by the stencil
+    MPI_Irecv(&m[1], len, scalar_type(), neighbours[0], 0, cart_comm, &requests[0]);
+    MPI_Irecv(&m[(n_row - 1)*n_col + 1], len, scalar_type(), neighbours[1], 0, cart_comm, &requests[1]);
+    MPI_Irecv(&m[n_col], 1, column_type, neighbours[2], 0, cart_comm, &requests[2]);
+    MPI_Irecv(&m[2*n_col - 1], 1, column_type, neighbours[3], 0, cart_comm, &requests[3]);
+
+    // Send the first and the last computed rows and columns to the neighbours
+    MPI_Isend(&m[n_col + 1], len, scalar_type(), neighbours[0], 0, cart_comm, &requests[4]);
+    MPI_Isend(&m[(n_row - 2)*n_col + 1], len, scalar_type(), neighbours[1], 0, cart_comm, &requests[5]);
+    MPI_Isend(&m[n_col + 1], 1, column_type, neighbours[2], 0, cart_comm, &requests[6]);
+    MPI_Isend(&m[2*n_col - 2], 1, column_type, neighbours[3], 0, cart_comm, &requests[7]);
+
+    n_requests = 8;
+    return;
+  }
+
+  // on the physical boundaries there is nothing to exchange
+  int up = rank == 0 ? MPI_PROC_NULL : rank - 1;
+  int down = rank == size - 1 ? MPI_PROC_NULL : rank + 1;
+
+  // Receive the ghost rows from the neighbours
+  MPI_Irecv(&m[0], n_col, scalar_type(), up, 0, MPI_COMM_WORLD, &requests[0]);
+  MPI_Irecv(&m[(n_row - 1)*n_col], n_col, scalar_type(), down, 0, MPI_COMM_WORLD, &requests[1]);
+
+  // Send the first and the last computed rows to the neighbours
+  MPI_Isend(&m[n_col], n_col, scalar_type(), up, 0, MPI_COMM_WORLD, &requests[2]);
+  MPI_Isend(&m[(n_row - 2)*n_col], n_col, scalar_type(), down, 0, MPI_COMM_WORLD, &requests[3]);
+
+  n_requests = 4;
+}
+
+template<typename T>
+void Solver<T>::accumulate_boundary(aligned_vector<T> & v) {
+  /**
+   * @brief Function to add the ghost cells of a vector of the block to the points of the neighbours which they overlap, the reverse
+   * of the exchange of the ghost cells
+   * @note it is used by the multigrid restriction, which adds contributions also to the points next to the block. The whole ghost
+   * rows are sent first and then the columns, so the contributions to the corners reach the diagonal neighbours in two steps
+   * @param v is the vector of the block, its ghost cells are set to zero
+   */
+
+  if(size == 1)
+    return;
+
+  const double start = MPI_Wtime();
+  const MPI_Comm comm = is_cartesian() ? cart_comm : MPI_COMM_WORLD;
+  const int up = is_cartesian() ? neighbours[0] : (rank == 0 ? MPI_PROC_NULL : rank - 1);
+  const int down = is_cartesian() ? neighbours[1] : (rank == size - 1 ? MPI_PROC_NULL : rank + 1);
+  ghost_sums.resize(std::max(n_row, n_col));
+
+  // the first ghost row goes to the last computed row of the process above, the last one to the first computed row of the process below
+  MPI_Sendrecv(&v[0], n_col, scalar_type(), up, 2, ghost_sums.data(), n_col, scalar_type(), down, 2, comm, MPI_STATUS_IGNORE);
+  if(down != MPI_PROC_NULL)
+    for(size_t c = 0; c < n_col; ++c)
+      v[(n_row - 2)*n_col + c] += ghost_sums[c];
+
+  MPI_Sendrecv(&v[(n_row - 1)*n_col], n_col, scalar_type(), down, 3, ghost_sums.data(), n_col, scalar_type(), up, 3, comm, MPI_STATUS_IGNORE);
+  if(up != MPI_PROC_NULL)
+    for(size_t c = 0; c < n_col; ++c)
+      v[n_col + c] += ghost_sums[c];
+
+  if(is_cartesian()){
+    // the ghost columns, with the corners received from the processes above and below
+    MPI_Sendrecv(&v[n_col], 1, column_type, neighbours[2], 4, ghost_sums.data(), n_row - 2, scalar_type(), neighbours[3], 4, comm, MPI_STATUS_IGNORE);
+    if(neighbours[3] != MPI_PROC_NULL)
+      for(size_t r = 1; r < n_row - 1; ++r)
+        v[r*n_col + n_col - 2] += ghost_sums[r - 1];
+
+    MPI_Sendrecv(&v[2*n_col - 1], 1, column_type, neighbours[3], 5, ghost_sums.data(), n_row - 2, scalar_type(), neighbours[2], 5, comm, MPI_STATUS_IGNORE);
+    if(neighbours[2] != MPI_PROC_NULL)
+      for(size_t r = 1; r < n_row - 1; ++r)
+        v[r*n_col + 1] += ghost_sums[r - 1];
   }
+
+  for(size_t c = 0; c < n_col; ++c)
+    v[c] = v[(n_row - 1)*n_col + c] = 0;
+  for(size_t r = 1; r < n_row - 1; ++r)
+    v[r*n_col] = v[r*n_col + n_col - 1] = 0;
+
+  times.halo += MPI_Wtime() - start;
 }
 
-void Solver::initial_communication(std::vector<double> & initial_mesh){
+template<typename T>
+double Solver<T>::jacobi_block(const size_t & r_begin, const size_t & r_end, const size_t & c_begin, const size_t & c_end, const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to update a block of the mesh using the Jacobi method with the kernel chosen in the conditions
+   * @param r_begin is the first row to update
+   * @param r_end is the row after the last one to update
+   * @param c_begin is the first column to update
+   * @param c_end is the column after the last one to update
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to compute also the squared difference with mesh_old
+   * @return sum of the squared differences of the block with mesh_old, 0 if residual is false
+   */
+
+  if(cond.kernel == 1)
+    return update_block_tiled(r_begin, r_end, c_begin, c_end, n_tasks, residual);
+
+  return update_block(r_begin, r_end, c_begin, c_end, n_tasks, residual);
+}
+
+template<typename T>
+void Solver<T>::jacobi(const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to update the whole mesh using the Jacobi method with the kernel chosen in the conditions
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to update also the error
+   */
+
+  if(cond.kernel == 1)
+    update_tiled(n_tasks, residual);
+  else
+    update_par(n_tasks, residual);
+}
+
+template<typename T>
+void Solver<T>::update_par_overlap(const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to update the mesh using the Jacobi method while the ghost cells are exchanged
+   * @note points far from the ghost cells are updated while the messages travel, the ones next to them once they arrived
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to update also the error
+   */
+
+  // swap the meshes, mesh_old holds the last iteration but its ghost cells are still the ones of the previous one
+  std::swap(mesh, mesh_old);
+
+  double start = MPI_Wtime();
+  start_communication_boundary(mesh_old.data());
+  times.halo += MPI_Wtime() - start;
+
+  // with the Cartesian decomposition also the first and the last columns are next to ghost cells
+  const size_t c_begin = is_cartesian() ? 2 : 1;
+  const size_t c_end = is_cartesian() ? n_col - 2 : n_col - 1;
+
+  // squared difference with the previous iteration, accumulated block by block
+  double sum = 0;
+
+  // interior points don't need the ghost cells
+  if(n_row > 4 && c_end > c_begin)
+    sum += jacobi_block(2, n_row - 2, c_begin, c_end, n_tasks, residual);
+
+  start = MPI_Wtime();
+  MPI_Waitall(n_requests, requests.data(), MPI_STATUSES_IGNORE);
+  times.halo += MPI_Wtime() - start;
+
+  // first and last computed rows (they are the same row if the process has only one)
+  sum += jacobi_block(1, 2, 1, n_col - 1, n_tasks, residual);
+  if(n_row > 3)
+    sum += jacobi_block(n_row - 2, n_row - 1, 1, n_col - 1, n_tasks, residual);
+
+  // first and last computed columns
+  if(is_cartesian() && n_row > 4){
+    sum += jacobi_block(2, n_row - 2, 1, 2, n_tasks, residual);
+    if(n_col > 3)
+      sum += jacobi_block(2, n_row - 2, n_col - 2, n_col - 1, n_tasks, residual);
+  }
+
+  if(residual)
+    error = std::sqrt(h*sum);
+}
+
+template<typename T>
+void Solver<T>::update_red_black_mpi(const double & omega, const int & n_tasks, const bool & residual) {
+  /**
+   * @brief Function to update the mesh using the red-black Gauss-Seidel method with MPI
+   * @note the ghost cells are exchanged after each colour since the other colour needs them
+   * @param omega is the relaxation factor
+   * @param n_tasks is the number of parallel tasks
+   * @param residual is true to update also the error
+   */
+
+  double sum = update_color(0, omega, n_tasks, residual);
+  communicate_boundary();
+
+  sum += update_color(1, omega, n_tasks, residual);
+  communicate_boundary();
+
+  if(residual)
+    error = std::sqrt(h*sum);
+}
+
+template<typename T>
+double Solver<T>::relaxation(const conditions & c) const {
+  /**
+   * @brief Function to choose the relaxation factor of the red-black methods
+   * @param c are the conditions of the solver
+   * @return the given or the estimated relaxation factor for SOR, 1 (Gauss-Seidel) otherwise
+   */
+
+  if(c.method != 2)
+    return 1;
+
+  return (c.omega > 0 && c.omega < 2) ? c.omega : optimal_omega();
+}
+
+template<typename T>
+int Solver<T>::iterate_team(const int & n_tasks){
+  /**
+   * @brief Function to iterate until convergence inside a single parallel region, without fork and join at each iteration
+   * @note the rows are shared with orphaned omp for, the master thread exchanges the ghost cells (MPI_THREAD_FUNNELED)
+   * and reduces the exit condition between two barriers. The ghost cells are always exchanged after the update, so overlap is ignored
+   * @param n_tasks is the number of threads of the team
+   * @return the number of iterations
+   */
+
+  const conditions & c = cond;
+  const double omega = relaxation(c);
+  const int check_every = std::max(c.check_every, 1);
+  const bool tiled = c.kernel == 1;
+
+  // pages of the meshes are placed by the threads which update them, only the first time
+  first_touch(n_tasks, tiled && c.method == 0);
+
+  int iter = first_iter;
+  bool stop = c.n_max <= first_iter;
+  double sum = 0;
+
+  // start of the sweeps of the current iteration, only read by the master thread
+  double start = 0, halo = 0;
+
+  // update_par swaps the meshes before the update
+  if(c.method == 0)
+    std::swap(mesh, mesh_old);
+
+  #pragma omp parallel num_threads(n_tasks) proc_bind(close)
+  for(int i = first_iter; !stop; ++i){
+    // the error is computed and reduced only every check_every iterations
+    const bool check = (i + 1)%check_every == 0 || i == c.n_max - 1;
+    double local = 0;
+
+    #pragma omp master
+    {
+      start = MPI_Wtime();
+      halo = times.halo;
+    }
+
+    if(c.method == 0)
+      local = update_block_team(1, n_row - 1, 1, n_col - 1, tiled, check);
+    else{
+      local = update_color_team(0, omega, check);
+
+      // the other colour needs the ghost cells of this one
+      #pragma omp barrier
+      #pragma omp master
+      communicate_boundary();
+      #pragma omp barrier
+
+      local += update_color_team(1, omega, check);
+    }
+
+    #pragma omp atomic
+    sum += local;
+
+    #pragma omp barrier
+
+    #pragma omp master
+    {
+      (check ? times.residual : times.kernel) += MPI_Wtime() - start - (times.halo - halo);
+      communicate_boundary();
+      ++iter;
+
+      if(check){
+        error = std::sqrt(h*sum);
+        int exit = (error < c.tolerance || i == c.n_max - 1) ? 1 : 0;
+
+        // Communicate local exit condition to all processes
+        const double t = MPI_Wtime();
+        if(size > 1)
+          MPI_Allreduce(MPI_IN_PLACE, &exit, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        times.allreduce += MPI_Wtime() - t;
+        stop = exit == size;
+      }
+      sum = 0;
+
+      periodic_output(i, i + 1);
+
+      if(c.method == 0 && !stop)
+        std::swap(mesh, mesh_old);
+    }
+
+    #pragma omp barrier
+  }
+
+  const double t = MPI_Wtime();
+  finish_checkpoint();
+  times.output += MPI_Wtime() - t;
+
+  return iter;
+}
+
+template<typename T>
+void Solver<T>::initial_communication(std::vector<T> & initial_mesh){
   /**
    * @brief Function to communicate the initial mesh
    * @param initial_mesh is the initial mesh to be communicated
   */
-  
+
+  const double start = MPI_Wtime();
+  if(is_cartesian()){
+    initial_communication_cartesian(initial_mesh);
+    times.setup += MPI_Wtime() - start;
+    return;
+  }
+
+  auto displacement = slab_layout();
+
+  // Send the initial mesh to the other threads
+  MPI_Scatterv(&initial_mesh[0], &send_counts[0], &displacement[0], scalar_type(), &mesh[0], send_counts[rank], scalar_type(), 0, MPI_COMM_WORLD);
+
+  // both meshes are read by the updates, so both need the boundary
+  mesh_old = mesh;
+  times.setup += MPI_Wtime() - start;
+}
+
+template<typename T>
+void Solver<T>::initial_condition(const std::string & boundary){
+  /**
+   * @brief Function to build the initial block of this process without the whole mesh, in place of the initial communication
+   * @note the boundary conditions are applied to the sides of the block on the boundary of the domain, the other points start from 0 as
+   * in the scattered mesh. f_eval is created from the offsets by the solution finder
+   * @param boundary is the function of the boundary conditions
+  */
+
+  const double start = MPI_Wtime();
+  if(!is_cartesian())
+    slab_layout();
+
+  auto error = add_boundary_condition(boundary, physical_sides());
+  if(error.has_value())
+    throw std::runtime_error(error.value());
+  times.setup += MPI_Wtime() - start;
+}
+
+template<typename T>
+std::vector<int> Solver<T>::slab_layout(){
+  /**
+   * @brief Function to compute how the rows of the mesh are split in slabs among processes
+   * @note it sets the offset of this process and the elements of each slab (send_counts)
+   * @return the displacement of each slab inside the whole mesh
+  */
+
   int row_eq_distr = (n_col - 2)/(size); // -2 since we have to row of border condition
   int remainder = (n_col - 2)%(size);
 
@@ -136,48 +681,427 @@ void Solver::initial_communication(std::vector<double> & initial_mesh){
   // Calculate element sent: n_row_each_process*n + 2*n which are boundaries
   send_counts.resize(size);
   std::transform(temp.begin(), temp.end(), send_counts.begin(), [this](int val){ return val != 0 ? val*n_col + 2*n_col : 0;} );
-  
-  // Send the initial mesh to the other threads
-  MPI_Scatterv(&initial_mesh[0], &send_counts[0], &displacement[0], MPI_DOUBLE, &mesh[0], send_counts[rank], MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+  return displacement;
 }
 
-void Solver::final_communication(std::vector<double> & final_mesh){
+template<typename T>
+void Solver<T>::final_communication(std::vector<T> & final_mesh){
   /**
    * @brief Function to communicate adn save the final mesh
-   * @param mesh is the mesh to be communicated
-   * @param final_mesh is the final mesh to be saved
-   * @param n is the number of points of column of the mesh
-   * @param f is the function to be computed
+   * @param final_mesh is where rank 0 gathers the final mesh for the ASCII output, it is allocated only then
   */
-  
-  // Remove boundaries rows from the mesh
-  std::transform(send_counts.begin(), send_counts.end(), send_counts.begin(), [this](int val){ return val != 0 ? val - 2*n_col : 0;} );
-  
-  // rows to be sent to the root process
-  std::vector<int> temp(size, 0);
-  std::transform(send_counts.begin(), send_counts.end(), temp.begin(), [this](int val){ return val/n_col;} );
-  
+
+  if(cond.output == 2)
+    write_pieces(output_name());
+
+  // the whole solution is needed on rank 0 only by the ASCII output
+  if(cond.output != 1)
+    return;
+
+  if(is_cartesian())
+    final_communication_cartesian(final_mesh);
+  else
+    final_communication_slabs(final_mesh);
+
+  if(rank == 0 && cond.output == 1)
+    write_output();
+}
+
+template<typename T>
+void Solver<T>::final_communication_slabs(std::vector<T> & final_mesh){
+  /**
+   * @brief Function to gather the final mesh from the slabs of rows on rank 0
+   * @note each process sends the rows it owns, so the first and the last process send also the boundary rows of the mesh and
+   * the gathered mesh is allocated here, only on rank 0
+   * @param final_mesh is where rank 0 gathers the final mesh, it is released once the mesh is saved
+  */
+
+  if(rank == 0)
+    final_mesh.resize(n_points*n_points);
+
+  // elements owned by each process: its computed rows, plus the first and the last row of the mesh
+  std::vector<int> counts(size, 0);
+  std::transform(send_counts.begin(), send_counts.end(), counts.begin(), [this](int val){ return val != 0 ? val - 2*n_col : 0;} );
+  counts[0] += n_col;
+  counts[size - 1] += n_col;
+
   // calculate the displacement, offset of which root process has to write data
   std::vector<int> displacement(size, 0);
   for(int i = 1; i < size; ++i){
-    displacement[i] = displacement[i-1] + send_counts[i-1];
+    displacement[i] = displacement[i-1] + counts[i-1];
   }
 
-  // Starting mesh from n to avoid the first row of boundary condition
-  MPI_Gatherv(&mesh[n_col], send_counts[rank], MPI_DOUBLE, &final_mesh[n_col], &send_counts[0], &displacement[0], MPI_DOUBLE, 0, MPI_COMM_WORLD);
-  
+  MPI_Gatherv(&mesh[rank == 0 ? 0 : n_col], counts[rank], scalar_type(), final_mesh.data(), &counts[0], &displacement[0], scalar_type(), 0, MPI_COMM_WORLD);
+
   if(rank == 0){
     // save the final mesh
-    mesh = final_mesh;
+    mesh.assign(final_mesh.begin(), final_mesh.end());
+    std::vector<T>().swap(final_mesh);
     n_row = n_col;
-  
-    // write the final mesh
-    std::string filename = "vtk_files/approx_sol-"+std::to_string(size)+"-" + std::to_string(n_col) + ".vtk";
-    write(filename);
+    offset = 0;
+  }
+}
+
+template<typename T>
+std::string Solver<T>::output_name() const{
+  /**
+   * @brief Function to build the name of the output files, without extension
+   * @return path of the output files
+  */
+
+  return "vtk_files/approx_sol-" + std::to_string(size) + "-" + std::to_string(n_points);
+}
+
+template<typename T>
+void Solver<T>::write_output() const{
+  /**
+   * @brief Function to write the whole mesh owned by this process in the format chosen in the conditions
+  */
+
+  std::optional<std::string> error;
+  if(cond.output == 1)
+    error = write(output_name() + ".vtk");
+  else if(cond.output == 2)
+    error = write_vti(output_name() + ".vti", n_row, n_col, n_row, n_col);
+
+  if(error.has_value())
+    std::cout << error.value() << std::endl;
+}
+
+template<typename T>
+void Solver<T>::write_pieces(const std::string & name){
+  /**
+   * @brief Function to write the mesh in parallel, each process writes its own block in a VTK XML image file
+   * @note the pieces share their last row (and column) with the first one of the next block, which is a ghost cell of it,
+   * so the ghost cells are exchanged once more. Rank 0 writes the .pvti file which lists all the pieces
+   * @param name is the path of the files without extension
+  */
+
+  communicate_boundary();
+
+  if(is_cartesian()){
+    // the corner ghost cell of the piece belongs to the diagonal neighbour: the columns are sent again together with the ghost rows,
+    // which are already updated
+    MPI_Datatype full_column;
+    MPI_Type_vector(n_row, 1, n_col, scalar_type(), &full_column);
+    MPI_Type_commit(&full_column);
+    MPI_Sendrecv(&mesh[n_col - 2], 1, full_column, neighbours[3], 2, &mesh[0], 1, full_column, neighbours[2], 2, cart_comm, MPI_STATUS_IGNORE);
+    MPI_Type_free(&full_column);
+  }
+
+  // the last block along a direction owns also the physical boundary
+  auto [first_row, last_row, first_col, last_col] = physical_sides();
+  const size_t rows = last_row ? n_row : n_row - 1;
+  const size_t cols = last_col ? n_col : n_col - 1;
+
+  const std::string piece = name + "-" + std::to_string(rank) + ".vti";
+  auto error = write_vti(piece, rows, cols, n_points, n_points);
+  if(error.has_value())
+    std::cout << "Rank " << rank << ": " << error.value() << std::endl;
+
+  // global extent of each piece
+  std::array<int, 4> local = {col_offset, col_offset + static_cast<int>(cols) - 1, offset, offset + static_cast<int>(rows) - 1};
+  std::vector<int> extents(rank == 0 ? 4*size : 0);
+  MPI_Gather(local.data(), 4, MPI_INT, extents.data(), 4, MPI_INT, 0, MPI_COMM_WORLD);
+
+  if(rank != 0)
+    return;
+
+  std::ofstream file(name + ".pvti");
+  if(!file.is_open()){
+    std::cout << "Unable to open the file, it may not exist or you don't have the right permissions" << std::endl;
+    return;
+  }
+
+  file << "<?xml version=\"1.0\"?>\n";
+  file << "<VTKFile type=\"PImageData\" version=\"1.0\">\n";
+  file << "  <PImageData GhostLevel=\"0\" " << image_attributes(n_points, n_points) << ">\n";
+  file << "    <PPointData Scalars=\"u\">\n";
+  file << "      <PDataArray type=\"" << vtk_type() << "\" Name=\"u\"/>\n";
+  file << "    </PPointData>\n";
+
+  // pieces are referenced relative to the .pvti file
+  const std::string base = name.substr(name.find_last_of('/') + 1);
+  for(int p = 0; p < size; ++p){
+    file << "    <Piece Extent=\"" << extents[4*p] << " " << extents[4*p + 1] << " " << extents[4*p + 2] << " " << extents[4*p + 3] << " 0 0\""
+         << " Source=\"" << base << "-" << p << ".vti\"/>\n";
+  }
+
+  file << "  </PImageData>\n";
+  file << "</VTKFile>\n";
+}
+
+template<typename T>
+std::array<bool, 4> Solver<T>::physical_sides() const{
+  /**
+   * @brief Function to find the sides of the local mesh which are on the boundary of the domain
+   * @return true for each of first row, last row, first column and last column on the boundary
+  */
+
+  if(is_cartesian())
+    return {neighbours[0] == MPI_PROC_NULL, neighbours[1] == MPI_PROC_NULL, neighbours[2] == MPI_PROC_NULL, neighbours[3] == MPI_PROC_NULL};
+
+  return {rank == 0, rank == size - 1, true, true};
+}
+
+template<typename T>
+std::array<size_t, 4> Solver<T>::owned_block() const{
+  /**
+   * @brief Function to find the points of the local mesh owned by this process, the blocks of all processes cover the whole mesh once
+   * @note they are the computed points plus the physical boundaries next to them
+   * @return first row, row after the last one, first column and column after the last one, in local indexes
+  */
+
+  auto [first_row, last_row, first_col, last_col] = physical_sides();
+
+  const size_t r_begin = first_row ? 0 : 1, c_begin = first_col ? 0 : 1;
+  return {r_begin, last_row ? n_row : n_row - 1, c_begin, last_col ? n_col : n_col - 1};
+}
+
+template<typename T>
+void Solver<T>::print_exact_distance() const{
+  /**
+   * @brief Function to print the distance of the mesh from the exact solution u of the conditions, to test this program
+   * @note each process sums on the points it owns, so the whole mesh is never needed
+  */
+
+  auto [r_begin, r_end, c_begin, c_end] = owned_block();
+
+  double sum = 0;
+  for(size_t r = r_begin; r < r_end; ++r){
+    for(size_t c = c_begin; c < c_end; ++c){
+      auto [x, y] = get_coordinates(r, c);
+      sum += std::pow(mesh[r*n_col + c] - cond.u(x, y), 2);
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+  if(rank == 0)
+    std::cout << "Error with exact solution: " << std::sqrt(h*sum) << std::endl;
+}
+
+template<typename T>
+void Solver<T>::start_checkpoint(const int & iter){
+  /**
+   * @brief Function to start the checkpoint of the mesh, the iteration and the error into a single file with collective MPI-IO
+   * @note the file is the header followed by the whole mesh, each process writes its own block through a subarray view, so a
+   * restart can use a different number of processes. The write is non-blocking: it goes on while the iterations continue
+   * and it is completed by finish_checkpoint, the file is renamed only then so a crash never leaves a broken checkpoint
+   * @param iter is the number of iterations done
+  */
+
+  finish_checkpoint();
+
+  // the values are copied, so the mesh can be updated during the write
+  auto [r_begin, r_end, c_begin, c_end] = owned_block();
+  checkpoint_buffer.resize((r_end - r_begin)*(c_end - c_begin));
+  for(size_t r = r_begin; r < r_end; ++r)
+    std::copy(mesh.begin() + r*n_col + c_begin, mesh.begin() + r*n_col + c_end, checkpoint_buffer.begin() + (r - r_begin)*(c_end - c_begin));
+
+  const std::string tmp = cond.checkpoint + ".tmp";
+  if(MPI_File_open(MPI_COMM_WORLD, tmp.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &checkpoint_file) != MPI_SUCCESS){
+    if(rank == 0)
+      std::cout << "Unable to open the checkpoint " << tmp << std::endl;
+    checkpoint_file = MPI_FILE_NULL;
+    return;
+  }
+  MPI_File_set_size(checkpoint_file, sizeof(checkpoint_header) + n_points*n_points*sizeof(double));
+
+  if(rank == 0){
+    checkpoint_header header = {{'J', 'A', 'C', 'O', 'B', 'I', '0', '1'}, n_points, iter, error};
+    MPI_File_write_at(checkpoint_file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+  }
+
+  // block of this process inside the whole mesh
+  std::array<int, 2> sizes = {static_cast<int>(n_points), static_cast<int>(n_points)};
+  std::array<int, 2> sub_sizes = {static_cast<int>(r_end - r_begin), static_cast<int>(c_end - c_begin)};
+  std::array<int, 2> starts = {offset + static_cast<int>(r_begin), col_offset + static_cast<int>(c_begin)};
+
+  MPI_Datatype block;
+  MPI_Type_create_subarray(2, sizes.data(), sub_sizes.data(), starts.data(), MPI_ORDER_C, MPI_DOUBLE, &block);
+  MPI_Type_commit(&block);
+
+  MPI_File_set_view(checkpoint_file, sizeof(checkpoint_header), MPI_DOUBLE, block, "native", MPI_INFO_NULL);
+  MPI_File_iwrite_all(checkpoint_file, checkpoint_buffer.data(), checkpoint_buffer.size(), MPI_DOUBLE, &checkpoint_request);
+
+  MPI_Type_free(&block);
+}
+
+template<typename T>
+void Solver<T>::finish_checkpoint(){
+  /**
+   * @brief Function to wait the checkpoint in progress, if any, and to replace the previous one with it
+  */
+
+  if(checkpoint_file == MPI_FILE_NULL)
+    return;
+
+  MPI_Wait(&checkpoint_request, MPI_STATUS_IGNORE);
+  MPI_File_close(&checkpoint_file);
+
+  if(rank == 0)
+    std::rename((cond.checkpoint + ".tmp").c_str(), cond.checkpoint.c_str());
+}
+
+template<typename T>
+void Solver<T>::periodic_output(const int & from, const int & to){
+  /**
+   * @brief Function to write the checkpoint and the snapshot when their period is inside the iterations just done
+   * @param from is the number of iterations done before the last update
+   * @param to is the number of iterations done after it
+  */
+
+  auto due = [&](const int & every){ return every > 0 && to/every > from/every; };
+
+  const double start = MPI_Wtime();
+  if(due(cond.checkpoint_every))
+    start_checkpoint(to);
+
+  if(due(cond.snapshot_every))
+    write_pieces(output_name() + "-iter-" + std::to_string(to));
+  times.output += MPI_Wtime() - start;
+}
+
+template<typename T>
+void Solver<T>::restart(){
+  /**
+   * @brief Function to load the mesh from the checkpoint, in place of the initial communication
+   * @note each process reads its block, ghost cells included, directly from the file with collective MPI-IO
+  */
+
+  const double start = MPI_Wtime();
+  if(!is_cartesian() && size > 1)
+    slab_layout();
+
+  MPI_File file;
+  if(MPI_File_open(MPI_COMM_WORLD, cond.checkpoint.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+    throw std::runtime_error("Unable to open the checkpoint " + cond.checkpoint);
+
+  checkpoint_header header;
+  MPI_File_read_at_all(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+
+  if(std::string(header.magic, 8) != "JACOBI01" || header.n_points != n_points){
+    MPI_File_close(&file);
+    throw std::runtime_error("The checkpoint " + cond.checkpoint + " doesn't belong to a mesh of " + std::to_string(n_points) + " points");
+  }
+
+  std::array<int, 2> sizes = {static_cast<int>(n_points), static_cast<int>(n_points)};
+  std::array<int, 2> sub_sizes = {static_cast<int>(n_row), static_cast<int>(n_col)};
+  std::array<int, 2> starts = {offset, col_offset};
+
+  MPI_Datatype block;
+  MPI_Type_create_subarray(2, sizes.data(), sub_sizes.data(), starts.data(), MPI_ORDER_C, MPI_DOUBLE, &block);
+  MPI_Type_commit(&block);
+
+  MPI_File_set_view(file, sizeof(checkpoint_header), MPI_DOUBLE, block, "native", MPI_INFO_NULL);
+  // the checkpoint is in double whatever the type of the mesh
+  std::vector<double> values(mesh.size());
+  MPI_File_read_all(file, values.data(), values.size(), MPI_DOUBLE, MPI_STATUS_IGNORE);
+
+  MPI_Type_free(&block);
+  MPI_File_close(&file);
+
+  mesh.assign(values.begin(), values.end());
+  mesh_old = mesh;
+  first_iter = header.iteration;
+  error = header.error;
+  times.setup += MPI_Wtime() - start;
+}
+
+template<typename T>
+void Solver<T>::initial_communication_cartesian(std::vector<T> & initial_mesh){
+  /**
+   * @brief Function to communicate the initial mesh to the blocks of the Cartesian decomposition
+   * @note each block is described on the root by a vector datatype, ghost cells included
+   * @param initial_mesh is the initial mesh to be communicated
+  */
+
+  MPI_Request recv_request;
+  MPI_Irecv(&mesh[0], mesh.size(), scalar_type(), 0, 0, cart_comm, &recv_request);
+
+  if(rank == 0){
+    std::vector<MPI_Datatype> types(size);
+    std::vector<MPI_Request> send_requests(size);
+
+    for(int p = 0; p < size; ++p){
+      auto [rows, cols, row_off, col_off] = cartesian_block(p);
+
+      MPI_Type_vector(rows, cols, n_points, scalar_type(), &types[p]);
+      MPI_Type_commit(&types[p]);
+      MPI_Isend(&initial_mesh[row_off*n_points + col_off], 1, types[p], p, 0, cart_comm, &send_requests[p]);
+    }
+
+    MPI_Waitall(size, send_requests.data(), MPI_STATUSES_IGNORE);
+    for(auto & t : types)
+      MPI_Type_free(&t);
+  }
+
+  MPI_Wait(&recv_request, MPI_STATUS_IGNORE);
+
+  // both meshes are read by the updates, so both need the boundary
+  mesh_old = mesh;
+}
+
+template<typename T>
+void Solver<T>::final_communication_cartesian(std::vector<T> & final_mesh){
+  /**
+   * @brief Function to communicate and save the final mesh from the blocks of the Cartesian decomposition
+   * @note each process sends the points it owns (see owned_block), physical boundaries included, so the gathered mesh is allocated
+   * here, only on rank 0
+   * @param final_mesh is where rank 0 gathers the final mesh, it is released once the mesh is saved
+  */
+
+  if(rank == 0)
+    final_mesh.resize(n_points*n_points);
+
+  // owned points of the local block
+  auto [r_begin, r_end, c_begin, c_end] = owned_block();
+  MPI_Datatype owned;
+  MPI_Type_vector(r_end - r_begin, c_end - c_begin, n_col, scalar_type(), &owned);
+  MPI_Type_commit(&owned);
+
+  MPI_Request send_request;
+  MPI_Isend(&mesh[r_begin*n_col + c_begin], 1, owned, 0, 1, cart_comm, &send_request);
+
+  if(rank == 0){
+    std::vector<MPI_Datatype> types(size);
+    std::vector<MPI_Request> recv_requests(size);
+
+    for(int p = 0; p < size; ++p){
+      auto [rows, cols, row_off, col_off] = cartesian_block(p);
+
+      // the blocks on the sides of the grid of processes own the boundary next to them
+      std::array<int, 2> coords;
+      MPI_Cart_coords(cart_comm, p, 2, coords.data());
+      const int first_row = coords[0] == 0 ? 0 : 1, last_row = coords[0] == dims[0] - 1 ? rows : rows - 1;
+      const int first_col = coords[1] == 0 ? 0 : 1, last_col = coords[1] == dims[1] - 1 ? cols : cols - 1;
+
+      MPI_Type_vector(last_row - first_row, last_col - first_col, n_points, scalar_type(), &types[p]);
+      MPI_Type_commit(&types[p]);
+      MPI_Irecv(&final_mesh[(row_off + first_row)*n_points + col_off + first_col], 1, types[p], p, 1, cart_comm, &recv_requests[p]);
+    }
+
+    MPI_Waitall(size, recv_requests.data(), MPI_STATUSES_IGNORE);
+    for(auto & t : types)
+      MPI_Type_free(&t);
+  }
+
+  MPI_Wait(&send_request, MPI_STATUS_IGNORE);
+  MPI_Type_free(&owned);
+
+  if(rank == 0){
+    // save the final mesh
+    mesh.assign(final_mesh.begin(), final_mesh.end());
+    std::vector<T>().swap(final_mesh);
+    n_row = n_col = n_points;
+    offset = col_offset = 0;
   }
 }
 
-void Solver::solution_finder_mpi(std::vector<double> & final_mesh, const int & thread){
+template<typename T>
+void Solver<T>::solution_finder_mpi(std::vector<T> & final_mesh, const int & thread){
   /**
    * @brief Function to find the solution of the mesh using MPI
    * @param final_mesh is the final mesh to be saved
@@ -185,35 +1109,430 @@ void Solver::solution_finder_mpi(std::vector<double> & final_mesh, const int & t
   */
 
   // Create evaluation of f
-  f_eval_creation();
+  double start = MPI_Wtime();
+  f_eval_creation(thread);
+  times.setup += MPI_Wtime() - start;
+
+  // Parallel computation
+  run(thread);
+
+  #if TEST == 1
+  print_exact_distance();
+  #endif
+
+  start = MPI_Wtime();
+  final_communication(final_mesh);
+  times.output += MPI_Wtime() - start;
+
+  report(thread);
+}
 
-  // Variables creation
-  conditions c;
-  int iter = 0;
-  double e = 10;
+template<typename T>
+int Solver<T>::iterate(const int & thread){
+  /**
+   * @brief Function to update the mesh with the method of the conditions until convergence or n_max iterations
+   * @param thread is the number of threads to be used by openMP
+   * @return the number of iterations
+  */
+
+  set_tiles(cond.tile_rows, cond.tile_cols);
+
+  if constexpr(std::is_same_v<T, double>){
+    if(cond.precision == 2)
+      return iterate_mixed(thread);
+  }
+
+  if(cond.device && cond.method == 0)
+    return iterate_device(thread);
+
+  return cond.persistent ? iterate_team(thread) : iterate_loop(thread);
+}
+
+template<typename T>
+int Solver<T>::iterate_mixed(const int & thread){
+  /**
+   * @brief Function to iterate with float sweeps and double precision iterative refinement
+   * @note every refine_every iterations the residual r = f + laplacian(u) of the double solution is computed in double and
+   * the float solver does the sweeps of the correction e (laplacian(e) = -r, e = 0 at the start and on the boundary), then e is added
+   * to u. The sweeps are linear, so the iterations and the error are the ones of the double solver, while the rounding of float is
+   * relative to the correction and not to the solution. The sweeps and the exchanges of the ghost cells move half of the bytes
+   * @param thread is the number of threads to be used by openMP
+   * @return the number of iterations
+  */
+
+  // a float solver has nothing to refine
+  if constexpr(!std::is_same_v<T, double>)
+    return iterate_loop(thread);
+  else{
+    // solver of the correction in float, with the same block of the mesh; the output is written from the double solution
+    Solver<float> low(*this);
+    conditions c = cond;
+    c.precision = 1;
+    c.checkpoint_every = c.snapshot_every = 0;
+    const int every = std::max(cond.refine_every, 1);
+
+    aligned_vector<T> r;
+    int iter = first_iter;
+    bool converged = false;
+
+    while(iter < cond.n_max && !converged){
+      double start = MPI_Wtime();
+      residual(r, thread);
+      low.f_eval.assign(r.begin(), r.end());
+      std::fill(low.mesh.begin(), low.mesh.end(), 0);
+      std::fill(low.mesh_old.begin(), low.mesh_old.end(), 0);
+      times.residual += MPI_Wtime() - start;
+
+      c.n_max = std::min(cond.n_max, iter + every);
+      low.set_conditions(c);
+      low.first_iter = iter;
+      const int done = low.iterate(thread);
+
+      // it stopped before the refinement only if all processes reached the tolerance, the error is computed at the last iteration
+      int exit = done < c.n_max || low.error < cond.tolerance ? 1 : 0;
+      if(done == c.n_max && size > 1)
+        MPI_Allreduce(MPI_IN_PLACE, &exit, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+      converged = exit == 1;
+
+      // ghost cells of the correction too, so the ghost cells of u are updated
+      low.communicate_boundary();
+
+      start = MPI_Wtime();
+      #pragma omp parallel for num_threads(thread)
+      for(size_t i = 0; i < mesh.size(); ++i)
+        mesh[i] += low.mesh[i];
+      times.residual += MPI_Wtime() - start;
+
+      error = low.error;
+      periodic_output(iter, done);
+      iter = done;
+    }
+
+    mesh_old = mesh;
+
+    times.kernel += low.times.kernel;
+    times.residual += low.times.residual;
+    times.halo += low.times.halo;
+    times.allreduce += low.times.allreduce;
+
+    const double start = MPI_Wtime();
+    finish_checkpoint();
+    times.output += MPI_Wtime() - start;
+
+    return iter;
+  }
+}
+
+template<typename T>
+int Solver<T>::iterate_loop(const int & thread){
+  /**
+   * @brief Function to update the mesh with the method of the conditions, with a parallel region for each update
+   * @note the time of each phase is added to times, the one of the exchanges inside the updates is not counted as kernel time
+   * @param thread is the number of threads to be used by openMP
+   * @return the number of iterations
+  */
+
+  const conditions & c = cond;
+  int iter = first_iter;
   int exit = n_row == 0 ? 1 : 0; // if the mesh is empty the local exit condition is reached
+  const double omega = relaxation(c);
+  const int check_every = std::max(c.check_every, 1);
 
-  // Parallel computation
-  auto start = std::chrono::high_resolution_clock::now();
+  // the tiled kernel can do several sweeps in a pass when there are no ghost cells to exchange between them
+  const int time_steps = (size == 1 && c.method == 0 && c.kernel == 1) ? std::max(c.time_steps, 1) : 1;
+
+  // the red-black methods and the overlap exchange the ghost cells inside the update
+  const bool exchanged = c.method != 0 || c.overlap;
+
+  int steps = 1;
+  for(int i = first_iter; i < c.n_max && exit < size; i += steps){
+    steps = std::min(time_steps, c.n_max - i);
+
+    // the error is computed and reduced only every check_every iterations (when one of them is inside the sweeps of this pass)
+    const bool check = (i + steps)/check_every > i/check_every || i + steps == c.n_max;
+
+    const double start = MPI_Wtime(), halo = times.halo;
+    if(c.method != 0)
+      update_red_black_mpi(omega, thread, check);
+    else if(steps > 1)
+      update_wavefront(steps, thread, check);
+    else if(c.overlap && size > 1)
+      update_par_overlap(thread, check);
+    else
+      jacobi(thread, check);
+    (check ? times.residual : times.kernel) += MPI_Wtime() - start - (times.halo - halo);
+    iter += steps;
+
+    if(check){
+      exit = (get_error() < c.tolerance || i + steps == c.n_max) ? 1 : 0;
+
+      // Communicate local exit condition to all processes
+      const double t = MPI_Wtime();
+      if(size > 1)
+        MPI_Allreduce(MPI_IN_PLACE, &exit, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+      times.allreduce += MPI_Wtime() - t;
+    }
+
+    // Communicate new boundary of each mesh to the other processes
+    if(!exchanged)
+      communicate_boundary();
+
+    periodic_output(i, i + steps);
+  }
 
-  for(int i = 0; i < c.n_max && exit < size ; ++i){
-    update_par(thread);
+  const double t = MPI_Wtime();
+  finish_checkpoint();
+  times.output += MPI_Wtime() - t;
+
+  return iter;
+}
+
+template<typename T>
+int Solver<T>::iterate_device(const int & thread){
+  /**
+   * @brief Function to update the mesh with the Jacobi method on the default OpenMP device until convergence or n_max iterations
+   * @note mesh, mesh_old and f_eval stay on the device during all the iterations, they are copied back to the host at the end
+   * (and by the checkpoints and the snapshots). Only the ghost cells move between host and device, unless DEVICE_MPI is defined:
+   * then the ghost cells are exchanged directly from the device memory by an MPI aware of it
+   * @param thread is the number of threads to be used by openMP, not used by the device
+   * @return the number of iterations
+  */
+
+  (void) thread;
+  const conditions & c = cond;
+  int iter = first_iter;
+  int exit = n_row == 0 ? 1 : 0; // if the mesh is empty the local exit condition is reached
+  const int check_every = std::max(c.check_every, 1);
+  auto due = [&](const int & every, const int & i){ return every > 0 && (i + 1)/every > i/every; };
+
+  // the mapping of the buffers follows them when the meshes are swapped
+  T * u = mesh.data();
+  T * u_old = mesh_old.data();
+  const T * f = f_eval.data();
+  const size_t n = mesh.size();
+
+  // first and last computed column, and then the ghost ones, of the Cartesian blocks
+  std::vector<T> edges(is_cartesian() ? 2*n_row : 0);
+  T * e = edges.data();
+  const size_t n_edges = edges.size();
+
+  #pragma omp target data map(tofrom: u[0:n], u_old[0:n]) map(to: f[0:n]) map(alloc: e[0:n_edges])
+  for(int i = first_iter; i < c.n_max && exit < size; ++i){
+    // the error is computed and reduced only every check_every iterations
+    const bool check = (i + 1)%check_every == 0 || i == c.n_max - 1;
+
+    const double start = MPI_Wtime();
+    this->update_device(check);
+    (check ? times.residual : times.kernel) += MPI_Wtime() - start;
     ++iter;
-    e = get_error();
-    exit = (e < c.tolerance || i == c.n_max - 1 ) ? 1 : 0;
 
-    // Communicate local exit condition to all threads
-    MPI_Allreduce(MPI_IN_PLACE, &exit, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if(check){
+      exit = (get_error() < c.tolerance || i == c.n_max - 1) ? 1 : 0;
+
+      // Communicate local exit condition to all processes
+      const double t = MPI_Wtime();
+      if(size > 1)
+        MPI_Allreduce(MPI_IN_PLACE, &exit, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+      times.allreduce += MPI_Wtime() - t;
+    }
+
+    communicate_boundary_device(e);
 
-    // Communicate new boundary of each mesh to the other processes 
-    communicate_boundary();
+    // the checkpoint and the snapshot are written from the host
+    if(due(c.checkpoint_every, i) || due(c.snapshot_every, i)){
+      T * current = mesh.data();
+      #pragma omp target update from(current[0:n])
+      periodic_output(i, i + 1);
+    }
   }
 
-  auto end = std::chrono::high_resolution_clock::now();
-  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  const double t = MPI_Wtime();
+  finish_checkpoint();
+  times.output += MPI_Wtime() - t;
 
-  if(rank == 0)
-    std::cout << "Time: " << duration.count() << " ms - Iter: " << iter << std::endl;
+  return iter;
+}
 
-  final_communication(final_mesh);
+template<typename T>
+void Solver<T>::communicate_boundary_device(T * edges){
+  /**
+   * @brief Function to communicate the ghost cells of the mesh on the device
+   * @note without DEVICE_MPI the computed cells next to the ghost ones are copied to the host, exchanged with communicate_boundary
+   * and the received ghost cells are copied back; the columns of the Cartesian blocks are packed in edges on the device
+   * @param edges is a buffer of 2*n_row values mapped on the device, used only by the Cartesian decomposition
+   */
+
+  if(size == 1)
+    return;
+
+  T * u = mesh.data();
+
+  #ifdef DEVICE_MPI
+  (void) edges;
+  const double start = MPI_Wtime();
+  #pragma omp target data use_device_ptr(u)
+  {
+    start_communication_boundary(u);
+    MPI_Waitall(n_requests, requests.data(), MPI_STATUSES_IGNORE);
+  }
+  times.halo += MPI_Wtime() - start;
+  #else
+  const size_t rows = n_row, cols = n_col;
+  #pragma omp target update from(u[cols:cols], u[(rows - 2)*cols:cols])
+
+  if(is_cartesian()){
+    #pragma omp target teams distribute parallel for
+    for(size_t r = 0; r < rows; ++r){
+      edges[r] = u[r*cols + 1];
+      edges[rows + r] = u[r*cols + cols - 2];
+    }
+    #pragma omp target update from(edges[0:2*rows])
+
+    for(size_t r = 0; r < rows; ++r){
+      u[r*cols + 1] = edges[r];
+      u[r*cols + cols - 2] = edges[rows + r];
+    }
+  }
+
+  communicate_boundary();
+
+  if(is_cartesian()){
+    for(size_t r = 0; r < rows; ++r){
+      edges[r] = u[r*cols];
+      edges[rows + r] = u[r*cols + cols - 1];
+    }
+    #pragma omp target update to(edges[0:2*rows])
+
+    #pragma omp target teams distribute parallel for
+    for(size_t r = 0; r < rows; ++r){
+      u[r*cols] = edges[r];
+      u[r*cols + cols - 1] = edges[rows + r];
+    }
+  }
+
+  #pragma omp target update to(u[0:cols], u[(rows - 1)*cols:cols])
+  #endif
 }
+
+template<typename T>
+int Solver<T>::run(const int & thread){
+  /**
+   * @brief Function to iterate once for each trial of the conditions, every trial starts from the same mesh
+   * @note the timings of each trial are saved in trial_times for the report
+   * @param thread is the number of threads to be used by openMP
+   * @return the number of iterations of the last trial
+  */
+
+  const int trials = std::max(cond.trials, 1);
+
+  // state restored before each trial (the initial mesh is copied only if there is more than one)
+  const aligned_vector<T> initial = trials > 1 ? mesh : aligned_vector<T>();
+  const double initial_error = error;
+
+  trial_times.clear();
+  int iter = first_iter;
+  for(int t = 0; t < trials; ++t){
+    if(t > 0){
+      mesh = initial;
+      mesh_old = initial;
+      error = initial_error;
+    }
+    times.kernel = times.residual = times.halo = times.allreduce = 0;
+
+    // the trials of all processes start together
+    MPI_Barrier(MPI_COMM_WORLD);
+    const double start = MPI_Wtime();
+    iter = iterate(thread);
+    times.wall = MPI_Wtime() - start;
+    times.iterations = iter - first_iter;
+    trial_times.push_back(times);
+
+    if(rank == 0)
+      std::cout << "Time: " << static_cast<long>(1000*times.wall) << " ms - Iter: " << iter << std::endl;
+  }
+
+  return iter;
+}
+
+template<typename T>
+void Solver<T>::report(const int & thread) const{
+  /**
+   * @brief Function to print the statistics of the trials and to append the timings of each process to the benchmark file
+   * @note nothing is done with a single trial and without benchmark file. Setup and output are done once, so they are the same
+   * for every trial. The updates are measured in millions of lattice
+   * updates per second (MLUP/s) of the interior points of the whole mesh, the bandwidth assumes 3 values per update
+   * (u_old and f read, u written, the neighbours are reused from cache) of the type of the sweeps. Both are left empty
+   * when an iteration is not a single sweep (the V-cycles of multigrid)
+   * @param thread is the number of threads used by openMP
+  */
+
+  if(cond.benchmark.empty() && trial_times.size() < 2)
+    return;
+
+  // timings of every trial of every process on rank 0
+  const int n_fields = 8;
+  std::vector<double> local;
+  local.reserve(n_fields*trial_times.size());
+  for(const auto & t : trial_times)
+    local.insert(local.end(), {t.wall, times.setup, t.kernel, t.residual, t.halo, t.allreduce, times.output, static_cast<double>(t.iterations)});
+
+  std::vector<double> all(rank == 0 ? local.size()*size : 0);
+  MPI_Gather(local.data(), local.size(), MPI_DOUBLE, all.data(), local.size(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+  if(rank != 0)
+    return;
+
+  const size_t trials = trial_times.size();
+  const double points = static_cast<double>(n_points - 2)*(n_points - 2);
+  const double bytes_per_update = 3*sweep_bytes();
+
+  // the time of a trial is the one of the slowest process
+  std::vector<double> wall(trials, 0);
+  for(int p = 0; p < size; ++p)
+    for(size_t t = 0; t < trials; ++t)
+      wall[t] = std::max(wall[t], all[(p*trials + t)*n_fields]);
+  auto mlups = [&](const size_t & t){ return trial_times[t].iterations*points/wall[t]/1e6; };
+
+  std::vector<double> sorted = wall;
+  std::sort(sorted.begin(), sorted.end());
+  const double median = trials%2 ? sorted[trials/2] : (sorted[trials/2 - 1] + sorted[trials/2])/2;
+  const double best = trial_times[0].iterations*points/sorted[0]/1e6;
+
+  std::cout << "Trials: " << trials << " - min: " << 1000*sorted[0] << " ms - median: " << 1000*median << " ms";
+  if(counts_updates())
+    std::cout << " - " << best << " MLUP/s - " << best*bytes_per_update/1000 << " GB/s";
+  std::cout << std::endl;
+
+  if(cond.benchmark.empty())
+    return;
+
+  // the header is written only in a new file
+  const bool empty = std::ifstream(cond.benchmark).peek() == std::ifstream::traits_type::eof();
+  std::ofstream file(cond.benchmark, std::ios::app);
+  if(!file.is_open()){
+    std::cout << "Unable to open the benchmark file " << cond.benchmark << std::endl;
+    return;
+  }
+
+  if(empty)
+    file << "Processes,Threads,Size,Method,Kernel,Decomposition,Trial,Rank,Iterations,Wall_s,Setup_s,Kernel_s,Residual_s,Halo_s,Allreduce_s,Output_s,MLUPs,GBs\n";
+
+  for(int p = 0; p < size; ++p){
+    for(size_t t = 0; t < trials; ++t){
+      const double * v = &all[(p*trials + t)*n_fields];
+      file << size << "," << thread << "," << n_points << "," << cond.method << "," << cond.kernel << "," << (is_cartesian() ? 2 : 1) << ","
+           << t << "," << p << "," << v[7];
+      for(int k = 0; k < 7; ++k)
+        file << "," << v[k];
+      if(counts_updates())
+        file << "," << mlups(t) << "," << mlups(t)*bytes_per_update/1000;
+      else
+        file << ",,";
+      file << "\n";
+    }
+  }
+}
+
+template class Solver<float>;
+template class Solver<double>;
+template Solver<float>::Solver(const Solver<double> &);
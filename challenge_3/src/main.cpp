@@ -1,9 +1,10 @@
-#include "Solver.hpp"
+#include "MultigridSolver.hpp"
+#include <map>
 
 bool check_input(int argc, char *argv[]){
   // check the number of arguments
-  if(argc != 5) {
-    std::cout << "Usage: " << argv[0] << " [point of the mesh]" << " [function]" << " [number of parallel task]"  << " [function of boundaries]"<< std::endl;
+  if(argc < 5) {
+    std::cout << "Usage: " << argv[0] << " [point of the mesh]" << " [function]" << " [number of parallel task]"  << " [function of boundaries]" << " [--option=value ...]" << std::endl;
     return false;
   }
 
@@ -22,60 +23,171 @@ bool check_input(int argc, char *argv[]){
   return true;
 }
 
-void distance_from_exact_solution(const Mesh & mesh){
+bool parse_options(int argc, char *argv[], conditions & cond){
   /**
-   * @brief Function to calculate the distance from the exact solution to test this program
-   * @param mesh is the mesh object of the approximate solution
-   * 
+   * @brief Function to override the default conditions with the options after the positional arguments
+   * @note an option is --name=value, where name is a field of conditions, --name alone is --name=1
+   * @param cond are the conditions to be updated
+   * @return true if all the options are valid, false otherwise
   */
 
-  conditions cond;
-  
-  double error = 0;
-  
-  for(size_t i = 0; i < mesh.get_size().first; ++i){
-    for(size_t j = 0; j < mesh.get_size().second; ++j){
-      auto [x, y] = mesh.get_coordinates(i, j);
-      error += pow(mesh.get_value(i, j) - cond.u(x, y), 2);
+  auto to_int = [](const std::string & v){ return std::stoi(v); };
+
+  std::map<std::string, std::function<void(const std::string &)>> options = {
+    {"tolerance", [&](const std::string & v){ cond.tolerance = std::stod(v); }},
+    {"n_max", [&](const std::string & v){ cond.n_max = to_int(v); }},
+    {"check_every", [&](const std::string & v){ cond.check_every = to_int(v); }},
+    {"method", [&](const std::string & v){ cond.method = to_int(v); }},
+    {"pre_smoothing", [&](const std::string & v){ cond.pre_smoothing = to_int(v); }},
+    {"post_smoothing", [&](const std::string & v){ cond.post_smoothing = to_int(v); }},
+    {"omega", [&](const std::string & v){ cond.omega = std::stod(v); }},
+    {"precision", [&](const std::string & v){ cond.precision = to_int(v); }},
+    {"refine_every", [&](const std::string & v){ cond.refine_every = to_int(v); }},
+    {"kernel", [&](const std::string & v){ cond.kernel = to_int(v); }},
+    {"tile_rows", [&](const std::string & v){ cond.tile_rows = to_int(v); }},
+    {"tile_cols", [&](const std::string & v){ cond.tile_cols = to_int(v); }},
+    {"time_steps", [&](const std::string & v){ cond.time_steps = to_int(v); }},
+    {"persistent", [&](const std::string & v){ cond.persistent = to_int(v) != 0; }},
+    {"device", [&](const std::string & v){ cond.device = to_int(v) != 0; }},
+    {"overlap", [&](const std::string & v){ cond.overlap = to_int(v) != 0; }},
+    {"distributed_setup", [&](const std::string & v){ cond.distributed_setup = to_int(v) != 0; }},
+    {"decomposition", [&](const std::string & v){ cond.decomposition = to_int(v); }},
+    {"output", [&](const std::string & v){ cond.output = to_int(v); }},
+    {"checkpoint_every", [&](const std::string & v){ cond.checkpoint_every = to_int(v); }},
+    {"checkpoint", [&](const std::string & v){ cond.checkpoint = v; }},
+    {"restart", [&](const std::string & v){ cond.restart = to_int(v) != 0; }},
+    {"snapshot_every", [&](const std::string & v){ cond.snapshot_every = to_int(v); }},
+    {"trials", [&](const std::string & v){ cond.trials = to_int(v); }},
+    {"benchmark", [&](const std::string & v){ cond.benchmark = v; }}
+  };
+
+  for(int i = 5; i < argc; ++i){
+    std::string arg = argv[i];
+    if(arg.find('=') == std::string::npos)
+      arg += "=1";
+    const size_t eq = arg.find('=');
+
+    if(arg.rfind("--", 0) != 0 || eq == std::string::npos || options.count(arg.substr(2, eq - 2)) == 0){
+      std::cout << "Unknown option " << arg << std::endl;
+      return false;
+    }
+
+    try{
+      options[arg.substr(2, eq - 2)](arg.substr(eq + 1));
+    }
+    catch(const std::exception &){
+      std::cout << "Invalid value of the option " << arg << std::endl;
+      return false;
     }
   }
 
-  std::cout << "Error with exact solution: " << sqrt(mesh.get_h()*error) << std::endl;
+  return true;
 }
 
-int main(int argc, char *argv[]) {
+template<typename T>
+std::vector<T> initial_mesh(const size_t & n, const Domain & domain, const std::string & f, const std::string & boundary){
+  /**
+   * @brief Function to create the whole initial mesh with the boundary conditions, to be scattered by rank 0
+   * @note the boundary is added by the Mesh like in the sequential run, the Mesh is released on return so only the values stay
+   * @param n is the number of points of each side of the mesh
+   * @param domain is the domain of the mesh
+   * @param f is the function to be solved
+   * @param boundary is the function of the boundary conditions
+   * @return the initial mesh
+  */
+
+  Mesh<T> mesh(n, n, domain, f);
+
+  auto error = mesh.add_boundary_condition(boundary);
+  if(error.has_value())
+    throw std::runtime_error(error.value());
+
+  return std::vector<T>(mesh.get_mesh().begin(), mesh.get_mesh().end());
+}
+
+template<class S, typename T>
+void run_mpi(S && sol, const conditions & cond, std::vector<T> & total_mesh, const std::string & boundary, const int & thread){
+  /**
+   * @brief Function to distribute the mesh, find the solution and collect it on rank 0
+   * @param sol is the solver (Solver or MultigridSolver) of the process
+   * @param cond are the conditions of the solver
+   * @param total_mesh is the whole initial mesh on rank 0 to be scattered, empty otherwise; rank 0 gathers the solution in it
+   * @param boundary is the function of the boundary conditions
+   * @param thread is the number of threads to be used by openMP
+  */
+
+  sol.set_conditions(cond);
+
+  // initial communication, each process reads its block from the checkpoint or builds it instead
+  if(cond.restart)
+    sol.restart();
+  else if(cond.distributed_setup)
+    sol.initial_condition(boundary);
+  else{
+    sol.initial_communication(total_mesh);
+
+    // the gathered mesh is allocated again only by the ASCII output
+    std::vector<T>().swap(total_mesh);
+  }
+
+  // find the solution
+  sol.solution_finder_mpi(total_mesh, thread);
+}
+
+template<typename T>
+void run_solver(const size_t & n, const Domain & domain, char *argv[], const conditions & cond){
+  /**
+   * @brief Function to build the solver of the conditions with values of type T and to find the solution
+   * @param n is the number of points of each side of the mesh
+   * @param domain is the domain of the mesh
+   * @param argv are the arguments of the program
+   * @param cond are the conditions of the solver
+  */
 
-  MPI_Init(&argc, &argv);
   int rank, size;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-  if(!check_input(argc, argv)){
-    MPI_Finalize();
-    return 1;
-  }
-  
-  size_t n = atoi(argv[1]);
-  Domain domain(0, 1, 0, 1);
+  // multigrid has its own solver with the same interface
+  const bool multigrid = cond.method == 3;
+
+  // the whole initial mesh is built by rank 0 only to be scattered, the final one is allocated by the gather of the ASCII output
+  const bool scatter = !cond.distributed_setup && !cond.restart;
 
   if(size == 1){
     // create a mesh
-    Mesh mesh(n, n, domain, argv[2]);
+    Mesh<T> mesh(n, n, domain, argv[2]);
 
     // cdd boundary condition
     mesh.add_boundary_condition(argv[4]);
 
-    // create the solver object
-    Solver sol(mesh);
-
-    // find the solution
-    auto solution_vec = sol.solution_finder_sequential();
-
-    #if TEST == 1
-    // run it only if build with test flag
-    distance_from_exact_solution(Mesh(solution_vec.value(), n, domain, argv[2]));
-    #endif
+    // create the solver object and find the solution
+    if(multigrid){
+      MultigridSolver<T> sol(mesh);
+      sol.set_conditions(cond);
+      if(cond.restart)
+        sol.restart();
+      sol.solution_finder_sequential(atoi(argv[3]));
+    }
+    else{
+      Solver<T> sol(mesh);
+      sol.set_conditions(cond);
+      if(cond.restart)
+        sol.restart();
+      sol.solution_finder_sequential(atoi(argv[3]));
+    }
+  }
+  else if(cond.decomposition == 2){
+    std::vector<T> total_mesh;
+    if(rank == 0 && scatter){
+      total_mesh = initial_mesh<T>(n, domain, argv[2], argv[4]);
+    }
 
+    // each process owns a block of the mesh
+    if(multigrid)
+      run_mpi(MultigridSolver<T>(n, domain, argv[2]), cond, total_mesh, argv[4], atoi(argv[3]));
+    else
+      run_mpi(Solver<T>(n, domain, argv[2]), cond, total_mesh, argv[4], atoi(argv[3]));
   }
   else{
     
@@ -97,39 +209,49 @@ int main(int argc, char *argv[]) {
     // std::vector<double> mesh_vec(rank <= remainder ? (row_eq_distr + 1)*n + 2*n : row_eq_distr*n + 2*n);
 
     // declare variable
-    std::vector<double> mesh_vec(temp[rank]*n != 0? temp[rank]*n + 2*n : 3*n, 0); //isn't it always temp[rank]*n + 2*n?
-    std::vector<double> total_mesh;
+    std::vector<T> mesh_vec(temp[rank]*n != 0? temp[rank]*n + 2*n : 3*n, 0); //isn't it always temp[rank]*n + 2*n?
+    std::vector<T> total_mesh;
 
     // correctly resize meshes
-    if(rank == 0){
-      total_mesh = std::vector<double>(n*n, 0); 
-
-      Mesh templ_mesh(total_mesh, n, domain, argv[2]); //why do you need templ_mesh? Try to avoid to save a copy of a possibly big matrix
-
-      // add border condition if needed
-      templ_mesh.add_boundary_condition(argv[4]);
-
-      // copy the mesh to the total mesh with border conditions
-      total_mesh.assign(templ_mesh.get_mesh().begin(), templ_mesh.get_mesh().end());
+    if(rank == 0 && scatter){
+      total_mesh = initial_mesh<T>(n, domain, argv[2], argv[4]);
     }
 
-    // initialize solver
-    Solver sol(mesh_vec, domain, n, argv[2]);
+    // initialize solver and find the solution
+    if(multigrid)
+      run_mpi(MultigridSolver<T>(mesh_vec, domain, n, argv[2]), cond, total_mesh, argv[4], atoi(argv[3]));
+    else
+      run_mpi(Solver<T>(mesh_vec, domain, n, argv[2]), cond, total_mesh, argv[4], atoi(argv[3]));
+  }
+}
 
-    // initial communication
-    sol.initial_communication(total_mesh);
+int main(int argc, char *argv[]) {
+
+  // only the master thread of a parallel region calls MPI
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    // find the solution
-    sol.solution_finder_mpi(total_mesh, atoi(argv[3]));    
+  if(provided < MPI_THREAD_FUNNELED && rank == 0)
+    std::cout << "Warning: MPI doesn't support calls from the master thread of a parallel region" << std::endl;
 
-    #if TEST == 1
-    // run it only if build with test flag
-    if(rank == 0){
-      distance_from_exact_solution(Mesh(total_mesh, n, domain, argv[2]));
-    }
-    #endif
+  conditions cond;
+  if(!check_input(argc, argv) || !parse_options(argc, argv, cond)){
+    MPI_Finalize();
+    return 1;
   }
   
+  size_t n = atoi(argv[1]);
+  Domain domain(0, 1, 0, 1);
+
+  // the mixed precision solver is a double solver which starts in float
+  if(cond.precision == 1)
+    run_solver<float>(n, domain, argv, cond);
+  else
+    run_solver<double>(n, domain, argv, cond);
+
   MPI_Finalize();
   return 0;
 }
@@ -1,8 +1,12 @@
 #include <mesh_data_class.hpp>
 
 #include <fstream>
+#include <sstream>
+#include <bit>
+#include <cstdint>
 
-mesh_data_class::mesh_data_class(const size_t & row_number, const size_t & col_number, const Domain & domain_): n_row(row_number), n_col(col_number), domain(domain_){
+template<typename T>
+mesh_data_class<T>::mesh_data_class(const size_t & row_number, const size_t & col_number, const Domain & domain_): n_row(row_number), n_col(col_number), domain(domain_){
     /**
      * @brief Constructor of the mesh_data_class
      * @param row_number is the number of rows of the mesh
@@ -24,7 +28,8 @@ mesh_data_class::mesh_data_class(const size_t & row_number, const size_t & col_n
     MPI_Comm_size(MPI_COMM_WORLD, &size);    
 }
 
-mesh_data_class::mesh_data_class(const std::vector<double> & _mesh, const size_t & col_number, const Domain & domain_): mesh(_mesh), mesh_old(_mesh), n_col(col_number), domain(domain_){
+template<typename T>
+mesh_data_class<T>::mesh_data_class(const std::vector<T> & _mesh, const size_t & col_number, const Domain & domain_): mesh(_mesh.begin(), _mesh.end()), mesh_old(_mesh.begin(), _mesh.end()), n_col(col_number), domain(domain_){
     /**
      * @brief Constructor of the mesh_data_class
      * @param _mesh is the mesh
@@ -43,7 +48,8 @@ mesh_data_class::mesh_data_class(const std::vector<double> & _mesh, const size_t
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 }
 
-void mesh_data_class::print() const {
+template<typename T>
+void mesh_data_class<T>::print() const {
     /**
      * @brief Function to print the mesh
     */
@@ -72,7 +78,8 @@ void mesh_data_class::print() const {
     std::cout << std::endl;
 }
 
-std::optional<std::string> mesh_data_class::write(const std::string & filename) const{
+template<typename T>
+std::optional<std::string> mesh_data_class<T>::write(const std::string & filename) const{
   /**
    * @brief Function to write the mesh in a vtk file in Legacy format
    * @param filename is the name of the file
@@ -85,22 +92,22 @@ std::optional<std::string> mesh_data_class::write(const std::string & filename)
   }
 
   // Title
-  file << "# vtk DataFile Version 3.0" << std::endl;
-  file << "3D mesh data" << std::endl;
+  file << "# vtk DataFile Version 3.0" << '\n';
+  file << "3D mesh data" << '\n';
 
   // Data type
-  file << "ASCII" << std::endl;
+  file << "ASCII" << '\n';
 
   // Geometry
-  file << "DATASET STRUCTURED_GRID" << std::endl;
-  file << "DIMENSIONS " << n_row << " " << n_col << " " << 1 << std::endl;
+  file << "DATASET STRUCTURED_GRID" << '\n';
+  file << "DIMENSIONS " << n_row << " " << n_col << " " << 1 << '\n';
 
   // Points
-  file << "POINTS " << n_row*n_col << " float" << std::endl;
+  file << "POINTS " << n_row*n_col << " float" << '\n';
   for(size_t i = 0; i < n_row; ++i) {
       for(size_t j = 0; j < n_col; ++j) {
         auto coords = get_coordinates(i, j);
-        file << coords.first << " " << coords.second << " " << mesh[i*n_col + j] << std::endl;
+        file << coords.first << " " << coords.second << " " << mesh[i*n_col + j] << '\n';
       }
   }
 
@@ -108,17 +115,99 @@ std::optional<std::string> mesh_data_class::write(const std::string & filename)
   return std::nullopt;
 }
 
-std::pair<double, double> mesh_data_class::get_coordinates(const size_t & r, const size_t & c) const{
+template<typename T>
+std::string mesh_data_class<T>::extent(const size_t & rows, const size_t & cols) const{
+  /**
+   * @brief Function to write the VTK extent of the first rows x cols points of the mesh
+   * @note the fastest VTK index runs over the columns of the mesh, the second one over the rows
+   * @param rows is the number of rows
+   * @param cols is the number of columns
+   * @return the extent in global indexes
+  */
+
+  std::ostringstream ext;
+  ext << col_offset << " " << col_offset + cols - 1 << " " << offset << " " << offset + rows - 1 << " 0 0";
+  return ext.str();
+}
+
+template<typename T>
+std::string mesh_data_class<T>::image_attributes(const size_t & whole_rows, const size_t & whole_cols) const{
+  /**
+   * @brief Function to write the attributes of the VTK image of the whole mesh
+   * @note the rows of the mesh go along x, so Direction swaps the two VTK axes
+   * @param whole_rows is the number of rows of the whole mesh
+   * @param whole_cols is the number of columns of the whole mesh
+   * @return WholeExtent, Origin, Spacing and Direction attributes
+  */
+
+  std::ostringstream attr;
+  attr << std::setprecision(17);
+  attr << "WholeExtent=\"0 " << whole_cols - 1 << " 0 " << whole_rows - 1 << " 0 0\" "
+       << "Origin=\"" << domain.x0 << " " << domain.y0 << " 0\" "
+       << "Spacing=\"" << h << " " << h << " " << h << "\" "
+       << "Direction=\"0 1 0 1 0 0 0 0 1\"";
+  return attr.str();
+}
+
+template<typename T>
+std::optional<std::string> mesh_data_class<T>::write_vti(const std::string & filename, const size_t & rows, const size_t & cols, const size_t & whole_rows, const size_t & whole_cols) const{
+  /**
+   * @brief Function to write the first rows x cols points of the mesh in a VTK XML image file with raw binary appended data
+   * @note the piece is placed inside the whole mesh with the offsets of the mesh, so each MPI process can write its own file
+   * @param filename is the name of the file
+   * @param rows is the number of rows to write
+   * @param cols is the number of columns to write
+   * @param whole_rows is the number of rows of the whole mesh
+   * @param whole_cols is the number of columns of the whole mesh
+   * @return nullptr if the mesh is written, error string otherwise
+  */
+
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+      return "Unable to open the file, it may not exist or you don't have the right permissions";
+  }
+
+  const char * byte_order = std::endian::native == std::endian::little ? "LittleEndian" : "BigEndian";
+
+  file << "<?xml version=\"1.0\"?>\n";
+  file << "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\"" << byte_order << "\" header_type=\"UInt64\">\n";
+  file << "  <ImageData " << image_attributes(whole_rows, whole_cols) << ">\n";
+  file << "    <Piece Extent=\"" << extent(rows, cols) << "\">\n";
+  file << "      <PointData Scalars=\"u\">\n";
+  file << "        <DataArray type=\"" << vtk_type() << "\" Name=\"u\" format=\"appended\" offset=\"0\"/>\n";
+  file << "      </PointData>\n";
+  file << "    </Piece>\n";
+  file << "  </ImageData>\n";
+  file << "  <AppendedData encoding=\"raw\">\n   _";
+
+  // size in bytes of the array, then the values row by row
+  const std::uint64_t bytes = rows*cols*sizeof(T);
+  file.write(reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+  for(size_t r = 0; r < rows; ++r)
+    file.write(reinterpret_cast<const char *>(&mesh[r*n_col]), cols*sizeof(T));
+
+  file << "\n  </AppendedData>\n";
+  file << "</VTKFile>\n";
+
+  if(!file)
+    return "Unable to write the file";
+
+  return std::nullopt;
+}
+
+template<typename T>
+std::pair<double, double> mesh_data_class<T>::get_coordinates(const size_t & r, const size_t & c) const{
     /**
      * @brief Function to get the coordinates of the mesh
      * @param r is the row index
      * @param c is the column index
      * @return x-y coordinates of a given rand c
     */ 
-    return std::make_pair(domain.x0 + (r + offset)*h, domain.y0 + c*h);
+    return std::make_pair(domain.x0 + (r + offset)*h, domain.y0 + (c + col_offset)*h);
 }
 
-std::optional<std::string> mesh_data_class::set_mesh(const std::vector<double> & _mesh) {
+template<typename T>
+std::optional<std::string> mesh_data_class<T>::set_mesh(const std::vector<T> & _mesh) {
     /**
      * @brief Function to set the mesh
      * @param _mesh is the mesh to be set
@@ -128,11 +217,12 @@ std::optional<std::string> mesh_data_class::set_mesh(const std::vector<double> &
         return "The size of the vector is not compatible with the mesh";
     }
 
-    mesh = _mesh;
+    mesh.assign(_mesh.begin(), _mesh.end());
     return std::nullopt;
 }
 
-std::optional<std::string> mesh_data_class::set_mesh_old(const std::vector<double> & _mesh) {
+template<typename T>
+std::optional<std::string> mesh_data_class<T>::set_mesh_old(const std::vector<T> & _mesh) {
     /**
      * @brief Function to set the mesh_old
      * @param _mesh is the mesh to be set
@@ -146,3 +236,5 @@ std::optional<std::string> mesh_data_class::set_mesh_old(const std::vector<doubl
     return std::nullopt;
 }
 
+template class mesh_data_class<float>;
+template class mesh_data_class<double>;
@@ -0,0 +1,62 @@
+#!/bin/bash
+
+# Check if the user is inside the tests folder
+if [ ! -d tests ]; then
+	echo "Error: You must run this script from the upper folder" >&2
+	exit 1
+fi
+
+# Check if the csv files exist and in case remove them
+for file in ./tests/strong.csv ./tests/weak.csv; do
+	if [ -f $file ]; then
+		rm $file
+	fi
+done
+
+# Compile the code optimized, without the distance from the exact solution
+make clean
+make mpi
+
+printf "\n##############################################################################################################\n"
+printf "This benchmark runs a fixed number of Jacobi iterations with 8*pi^2*sin(2*pi*x)*sin(2*pi*y) as f.\n"
+printf "Strong scaling keeps the size of the mesh, weak scaling keeps the points of each process (the side grows as sqrt of processes).\n"
+printf "The timings of each trial and process are saved on strong.csv and weak.csv inside this folder, plot_script.R plots them.\n"
+printf "Other options of the solver (e.g. --kernel=1 --persistent) can be given as arguments of this script.\n"
+printf "##############################################################################################################\n"
+
+# Prompt the user for the parameters of the benchmark
+printf "\n1) Insert the size of the mesh (of a single process for weak scaling): "
+read size
+printf "2) Insert max number of process of MPI to test: "
+read thread
+printf "3) Insert the number of iterations: "
+read iterations
+printf "4) Insert the number of trials: "
+read trials
+
+# Check if the inputs are valid numbers
+for value in "$size" "$thread" "$iterations" "$trials"; do
+	if ! [[ "$value" =~ ^[0-9]+$ ]] || ((value < 1)); then
+		echo "Error: $value is not a valid number" >&2
+		exit 1
+	fi
+done
+
+# the tolerance is never reached, so every run does the same iterations
+options="--tolerance=0 --n_max=$iterations --output=0 --trials=$trials $*"
+
+printf "\nStarting strong scaling:\n\n"
+for ((j = 1; j <= thread; j++)); do
+	printf "########### Processes %d: with %d grid points ###########\n" "$j" "$size"
+	mpiexec -n $j ./main $size "8*pi^2*sin(2*pi*x)*sin(2*pi*y)" 1 "0" $options --benchmark=tests/strong.csv
+	printf "\n"
+done
+
+printf "\nStarting weak scaling:\n\n"
+for ((j = 1; j <= thread; j++)); do
+	# same number of interior points for each process
+	weak_size=$(awk -v n=$size -v p=$j 'BEGIN { printf "%d", (n - 2)*sqrt(p) + 2.5 }')
+	printf "########### Processes %d: with %d grid points ###########\n" "$j" "$weak_size"
+	mpiexec -n $j ./main $weak_size "8*pi^2*sin(2*pi*x)*sin(2*pi*y)" 1 "0" $options --benchmark=tests/weak.csv
+	printf "\n"
+done